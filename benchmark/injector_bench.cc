@@ -0,0 +1,320 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "libpressio_ext/cpp/libpressio.h"
+#include "libpressio_error_injector.h"
+
+/**
+ * \file
+ * measures the throughput of random_error_injector and fault_injector
+ *
+ * each measurement is printed to stdout as one JSON object per line so results can be collected and compared over
+ * time.  For random_error_injector every generator, distribution, dtype, and buffer size is measured; for fault_injector
+ * injection counts and bit error rates over buffer sizes are measured.
+ */
+
+namespace {
+  struct bench_config {
+    size_t min_bytes = size_t{1} << 10;
+    size_t max_bytes = size_t{1} << 26;
+    double min_seconds = 0.05;
+    unsigned int nthreads = 1;
+    unsigned int setup_repetitions = 16;
+  };
+
+  struct dtype_info {
+    const char* name;
+    pressio_dtype dtype;
+    bool is_real;
+  };
+
+  const std::vector<dtype_info> dtypes {
+    {"float", pressio_float_dtype, true},
+    {"double", pressio_double_dtype, true},
+    {"int32", pressio_int32_dtype, false},
+    {"uint8", pressio_uint8_dtype, false},
+  };
+
+  using bench_clock = std::chrono::steady_clock;
+
+  double seconds_since(bench_clock::time_point begin) {
+    return std::chrono::duration<double>(bench_clock::now() - begin).count();
+  }
+
+  /**
+   * the result of calling compress repeatedly for at least min_seconds
+   */
+  struct timing {
+    uint64_t iterations = 0;
+    double seconds_per_call = 0;
+    int error = 0;
+    std::string error_msg;
+  };
+
+  timing time_compress(pressio_compressor& compressor, pressio_data const& input, double min_seconds) {
+    timing result;
+    pressio_data output = pressio_data::empty(pressio_byte_dtype, {});
+    auto begin = bench_clock::now();
+    double elapsed = 0;
+    do {
+      if((result.error = compressor->compress(&input, &output))) {
+        result.error_msg = compressor->error_msg();
+        return result;
+      }
+      ++result.iterations;
+      elapsed = seconds_since(begin);
+    } while(elapsed < min_seconds);
+    result.seconds_per_call = elapsed / static_cast<double>(result.iterations);
+    return result;
+  }
+
+  /**
+   * \returns args as an option value
+   */
+  pressio_data args_data(std::vector<double> const& args) {
+    return pressio_data::copy(pressio_double_dtype, args.data(), {args.size()});
+  }
+
+  /**
+   * measures the latency of the first call after the generator and distributions are rebuilt
+   *
+   * generators and distributions are cached per thread by their names and arguments, not the seed, so each repetition
+   * moves the last argument down by one more ulp to force a rebuild without changing the distribution meaningfully
+   */
+  timing time_setup(pressio_compressor& compressor, std::vector<double> const& args, dtype_info const& dtype, unsigned int repetitions) {
+    timing result;
+    pressio_data input = pressio_data::owning(dtype.dtype, {1});
+    std::memset(input.data(), 0, input.size_in_bytes());
+    pressio_data output = pressio_data::empty(pressio_byte_dtype, {});
+    std::vector<double> unique_args = args;
+    double total = 0;
+    for (unsigned int i = 0; i < repetitions; ++i) {
+      if(!unique_args.empty()) unique_args.back() = std::nextafter(unique_args.back(), 0.0);
+      compressor->set_options({{"random_error_injector:dist_args", args_data(unique_args)}});
+      auto begin = bench_clock::now();
+      if((result.error = compressor->compress(&input, &output))) {
+        result.error_msg = compressor->error_msg();
+        break;
+      }
+      total += seconds_since(begin);
+      ++result.iterations;
+    }
+    compressor->set_options({{"random_error_injector:dist_args", args_data(args)}});
+    if(result.iterations > 0) result.seconds_per_call = total / result.iterations;
+    return result;
+  }
+
+  /**
+   * \returns arguments valid for each registered distribution, the location and scale 0 and 1 unless the distribution
+   * needs positive or probability parameters
+   */
+  std::vector<double> distribution_args(std::string const& distribution) {
+    static const std::map<std::string, std::vector<double>> args {
+      {"chi_squared_distribution", {1}},
+      {"student_t_distribution", {1}},
+      {"fisher_f_distribution", {1, 1}},
+      {"gamma_distribution", {1, 1}},
+      {"weibull_distribution", {1, 1}},
+      {"binomial_distribution", {1, 0.5}},
+      {"negative_binomial_distribution", {1, 0.5}},
+      {"geometric_distribution", {0.5}},
+      {"poisson_distribution", {1}},
+    };
+    auto it = args.find(distribution);
+    return (it != args.end()) ? it->second : std::vector<double>{0, 1};
+  }
+
+  /**
+   * \returns value quoted as a JSON string
+   */
+  std::string json_string(std::string const& value) {
+    std::ostringstream quoted;
+    quoted << '"';
+    for (char c : value) {
+      switch(c) {
+        case '"': quoted << "\\\""; break;
+        case '\\': quoted << "\\\\"; break;
+        case '\n': quoted << "\\n"; break;
+        case '\t': quoted << "\\t"; break;
+        default:
+          if(static_cast<unsigned char>(c) < 0x20) {
+            quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+          } else {
+            quoted << c;
+          }
+      }
+    }
+    quoted << '"';
+    return quoted.str();
+  }
+
+  std::vector<size_t> buffer_sizes(bench_config const& config) {
+    std::vector<size_t> sizes;
+    for (size_t bytes = config.min_bytes; bytes <= config.max_bytes; bytes *= 4) {
+      sizes.push_back(bytes);
+    }
+    return sizes;
+  }
+
+  /**
+   * prints one measurement
+   *
+   * \returns false if the measurement failed
+   */
+  bool report(std::ostringstream& fields, size_t bytes, size_t elements, timing const& result) {
+    std::cout << "{" << fields.str()
+      << ",\"bytes\":" << bytes
+      << ",\"elements\":" << elements;
+    if(result.error) {
+      std::cout << ",\"error\":" << result.error << ",\"error_msg\":" << json_string(result.error_msg) << "}" << std::endl;
+      return false;
+    }
+    std::cout << ",\"iterations\":" << result.iterations
+      << ",\"seconds_per_call\":" << result.seconds_per_call
+      << ",\"elements_per_second\":" << static_cast<double>(elements) / result.seconds_per_call
+      << ",\"bytes_per_second\":" << static_cast<double>(bytes) / result.seconds_per_call
+      << "}" << std::endl;
+    return true;
+  }
+
+  /**
+   * \returns the number of failed measurements
+   */
+  size_t bench_random_error_injector(pressio& library, bench_config const& config) {
+    pressio_compressor compressor = library.get_compressor("random_error_injector");
+    pressio_options configuration = compressor->get_configuration();
+    std::vector<std::string> generators, real_distributions, int_distributions;
+    configuration.get("random_error_injector:generators", &generators);
+    configuration.get("random_error_injector:real_distributions", &real_distributions);
+    configuration.get("random_error_injector:int_distributions", &int_distributions);
+    compressor->set_options({
+        {"random_error_injector:seed", 0u},
+        {"random_error_injector:nthreads", config.nthreads},
+    });
+
+    size_t failures = 0;
+    for (auto const& generator : generators) {
+      for (auto const& dtype : dtypes) {
+        for (auto const& distribution : (dtype.is_real ? real_distributions : int_distributions)) {
+          const std::vector<double> args = distribution_args(distribution);
+          compressor->set_options({
+              {"random_error_injector:gen_name", generator},
+              {"random_error_injector:dist_name", distribution},
+              {"random_error_injector:dist_args", args_data(args)},
+          });
+          const timing setup = time_setup(compressor, args, dtype, config.setup_repetitions);
+          for (size_t bytes : buffer_sizes(config)) {
+            const size_t elements = bytes / pressio_dtype_size(dtype.dtype);
+            pressio_data input = pressio_data::owning(dtype.dtype, {elements});
+            std::memset(input.data(), 0, input.size_in_bytes());
+            std::ostringstream fields;
+            fields << "\"plugin\":\"random_error_injector\""
+              << ",\"generator\":\"" << generator << "\""
+              << ",\"distribution\":\"" << distribution << "\""
+              << ",\"dtype\":\"" << dtype.name << "\""
+              << ",\"nthreads\":" << config.nthreads;
+            if(setup.error) {
+              failures += !report(fields, bytes, elements, setup);
+              continue;
+            }
+            fields << ",\"setup_seconds\":" << setup.seconds_per_call;
+            failures += !report(fields, bytes, elements, time_compress(compressor, input, config.min_seconds));
+          }
+        }
+      }
+    }
+    return failures;
+  }
+
+  /**
+   * \returns the number of failed measurements
+   */
+  size_t bench_fault_injector(pressio& library, bench_config const& config) {
+    pressio_compressor compressor = library.get_compressor("fault_injector");
+    compressor->set_options({
+        {"fault_injector:seed", 0u},
+        {"fault_injector:nthreads", config.nthreads},
+    });
+    const std::vector<unsigned int> injection_counts {1, 1000, 1000000};
+    const std::vector<double> bit_error_rates {1e-6, 1e-3};
+
+    size_t failures = 0;
+    for (size_t bytes : buffer_sizes(config)) {
+      pressio_data input = pressio_data::owning(pressio_uint8_dtype, {bytes});
+      std::memset(input.data(), 0, input.size_in_bytes());
+      for (unsigned int injections : injection_counts) {
+        compressor->set_options({
+            {"fault_injector:injections", injections},
+            {"fault_injector:bit_error_rate", 0.0},
+        });
+        std::ostringstream fields;
+        fields << "\"plugin\":\"fault_injector\""
+          << ",\"injections\":" << injections
+          << ",\"nthreads\":" << config.nthreads;
+        failures += !report(fields, bytes, bytes, time_compress(compressor, input, config.min_seconds));
+      }
+      for (double rate : bit_error_rates) {
+        compressor->set_options({{"fault_injector:bit_error_rate", rate}});
+        std::ostringstream fields;
+        fields << "\"plugin\":\"fault_injector\""
+          << ",\"bit_error_rate\":" << rate
+          << ",\"nthreads\":" << config.nthreads;
+        failures += !report(fields, bytes, bytes, time_compress(compressor, input, config.min_seconds));
+      }
+    }
+    return failures;
+  }
+
+  void usage(const char* program) {
+    std::cerr << "usage: " << program << " [options]\n"
+      << "  --min-bytes N   smallest buffer size in bytes (default 1024)\n"
+      << "  --max-bytes N   largest buffer size in bytes, sizes grow by 4x (default 67108864)\n"
+      << "  --min-time S    minimum seconds to spend on each measurement (default 0.05)\n"
+      << "  --nthreads N    threads used by the injectors (default 1)\n"
+      << "  --random-only   only measure random_error_injector\n"
+      << "  --fault-only    only measure fault_injector\n"
+      << "results are written to stdout as one JSON object per line, the exit status is non-zero if any measurement failed" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  libpressio_register_error_injector();
+  bench_config config;
+  bool run_random = true, run_fault = true;
+  for (int i = 1; i < argc; ++i) {
+    std::string const arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if(arg == "--min-bytes" && has_value) config.min_bytes = std::strtoull(argv[++i], nullptr, 10);
+    else if(arg == "--max-bytes" && has_value) config.max_bytes = std::strtoull(argv[++i], nullptr, 10);
+    else if(arg == "--min-time" && has_value) config.min_seconds = std::strtod(argv[++i], nullptr);
+    else if(arg == "--nthreads" && has_value) config.nthreads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+    else if(arg == "--random-only") run_fault = false;
+    else if(arg == "--fault-only") run_random = false;
+    else {
+      usage(argv[0]);
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+  if(config.min_bytes == 0) {
+    std::cerr << "--min-bytes must be positive" << std::endl;
+    return 1;
+  }
+
+  pressio library;
+  size_t failures = 0;
+  if(run_random) failures += bench_random_error_injector(library, config);
+  if(run_fault) failures += bench_fault_injector(library, config);
+  if(failures > 0) {
+    std::cerr << failures << " measurements failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_BLOCK_STREAMS_H
+#define LIBPRESSIO_ERROR_INJECTOR_BLOCK_STREAMS_H
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include "random_distributions.h"
+#include "parallel_for.h"
+
+/**
+ * calls f(offset, len, block_gen, block_dist) for each block of n elements using up to nthreads threads
+ *
+ * block i covers elements [i*block, min((i+1)*block, n)) and draws from generator_for_block(gen, seed, first_block+i)
+ * with a distribution in the state of dist, so the samples of each block depend only on its position in the stream
+ * and never on nthreads.  A serial loop reuses dist, threads each use their own clone.
+ */
+template <class T, class Function>
+void for_each_block(size_t n, size_t block, unsigned int nthreads, polymorphic_generator& gen,
+    polymorphic_distribution<T>& dist, unsigned int seed, size_t first_block, Function&& f) {
+  const size_t blocks = (n + block - 1) / block;
+  const bool serial = std::min<size_t>(nthreads, blocks) <= 1;
+  parallel_for(blocks, nthreads, [&](size_t i) {
+    auto block_gen = generator_for_block(gen, seed, first_block + i);
+    std::unique_ptr<polymorphic_distribution<T>> block_copy;
+    polymorphic_distribution<T>* block_dist = &dist;
+    if(serial) {
+      dist.reset();
+    } else {
+      block_copy = dist.clone();
+      block_dist = block_copy.get();
+    }
+    f(i * block, std::min(block, n - i * block), *block_gen, *block_dist);
+  });
+}
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_BLOCK_STREAMS_H */
@@ -0,0 +1,164 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_CORRELATED_NOISE_H
+#define LIBPRESSIO_ERROR_INJECTOR_CORRELATED_NOISE_H
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "parallel_for.h"
+
+/**
+ * \returns the weights of a Gaussian kernel with standard deviation sigma elements truncated at 3 sigma or max_radius
+ * elements from the center, whichever is smaller, normalized so the sum of the squared weights is one and convolving
+ * zero mean white noise preserves its variance
+ */
+inline std::vector<double> gaussian_kernel(double sigma, size_t max_radius = std::numeric_limits<size_t>::max()) {
+  const size_t radius = std::min(max_radius, static_cast<size_t>(std::ceil(3 * sigma)));
+  std::vector<double> weights(2 * radius + 1);
+  double norm = 0;
+  for (size_t t = 0; t < weights.size(); ++t) {
+    const double x = static_cast<double>(t) - static_cast<double>(radius);
+    weights[t] = std::exp(-x * x / (2 * sigma * sigma));
+    norm += weights[t] * weights[t];
+  }
+  norm = std::sqrt(norm);
+  for (auto& weight : weights) {
+    weight /= norm;
+  }
+  return weights;
+}
+
+namespace correlated_noise_detail {
+  /**
+   * copies the len lines of tile elements starting at line 0 of in, spaced stride apart, into padded with radius lines
+   * of periodic padding on each side; radius must be less than len
+   */
+  template <class T>
+  void pad_lines(T const* in, size_t stride, size_t len, size_t tile, size_t radius, T* padded) {
+    for (size_t j = 0; j < len + 2 * radius; ++j) {
+      const size_t source = (j + len - radius) % len;
+      std::copy(in + source * stride, in + source * stride + tile, padded + j * tile);
+    }
+  }
+
+  /**
+   * \returns the mean of the n elements of data, summed in chunks whose partial sums are added in order so the result
+   * does not depend on nthreads
+   */
+  template <class T>
+  double mean(T const* data, size_t n, size_t chunk, unsigned int nthreads) {
+    const size_t chunks = (n + chunk - 1) / chunk;
+    std::vector<double> sums(chunks);
+    parallel_for(chunks, nthreads, [&](size_t i) {
+      double sum = 0;
+      for (size_t j = i * chunk, last = std::min(n, (i + 1) * chunk); j < last; ++j) {
+        sum += static_cast<double>(data[j]);
+      }
+      sums[i] = sum;
+    });
+    double total = 0;
+    for (double sum : sums) total += sum;
+    return total / static_cast<double>(n);
+  }
+
+  /**
+   * adds value to each of the n elements of data
+   */
+  template <class T>
+  void shift(T* data, size_t n, T value, size_t chunk, unsigned int nthreads) {
+    parallel_for((n + chunk - 1) / chunk, nthreads, [=](size_t i) {
+      for (size_t j = i * chunk, last = std::min(n, (i + 1) * chunk); j < last; ++j) {
+        data[j] += value;
+      }
+    });
+  }
+}
+
+/**
+ * convolves data in place with a separable Gaussian kernel, turning white noise into a Gaussian random field
+ *
+ * \param[in,out] data the noise, dimension 0 varies fastest
+ * \param[in] dims the dimensions of data
+ * \param[in] lengths the correlation length in elements along each dimension; missing or non-positive entries leave that
+ * dimension uncorrelated
+ * \param[in] nthreads the number of threads to use
+ *
+ * The mean of data is removed before convolving and restored afterwards, so both the mean and the variance of the noise
+ * are preserved; convolving noise with a non-zero mean directly would scale its mean by the sum of the weights.  Each
+ * kernel is truncated to fit within one period of its dimension so the periodic boundary never counts a sample twice.
+ *
+ * Each dimension is a separate pass costing O(n*k) for a kernel of k weights.  A pass works on tiles of lines that fit
+ * in cache: the lines are copied to a buffer with periodic padding, and the kernel is applied with the innermost loop
+ * over contiguous elements so it vectorizes.  Slabs of tiles are processed in parallel.
+ */
+template <class T>
+void correlate(T* data, std::vector<size_t> const& dims, std::vector<double> const& lengths, unsigned int nthreads) {
+  constexpr size_t tile_elements = 1 << 14;
+  size_t n = 1;
+  for (size_t dim : dims) n *= dim;
+  if(n == 0) return;
+  const T offset = static_cast<T>(correlated_noise_detail::mean(data, n, tile_elements, nthreads));
+  correlated_noise_detail::shift(data, n, static_cast<T>(-offset), tile_elements, nthreads);
+
+  size_t inner = 1;
+  for (size_t d = 0; d < dims.size(); inner *= dims[d], ++d) {
+    const size_t len = dims[d];
+    if(d >= lengths.size() || !(lengths[d] > 0) || len <= 1) continue;
+    const std::vector<double> weights_double = gaussian_kernel(lengths[d], (len - 1) / 2);
+    const std::vector<T> weights(weights_double.begin(), weights_double.end());
+    const size_t radius = weights.size() / 2;
+    const size_t outer = n / (inner * len);
+
+    if(inner == 1) {
+      //lines are contiguous, so vectorize along the line and give each task a group of lines
+      const size_t lines_per_task = std::max<size_t>(1, tile_elements / len);
+      parallel_for((outer + lines_per_task - 1) / lines_per_task, nthreads, [&](size_t task) {
+        std::vector<T> padded(len + 2 * radius);
+        std::vector<T> acc(len);
+        const size_t last = std::min(outer, (task + 1) * lines_per_task);
+        for (size_t line = task * lines_per_task; line < last; ++line) {
+          T* values = data + line * len;
+          correlated_noise_detail::pad_lines(values, 1, len, 1, radius, padded.data());
+          std::fill(acc.begin(), acc.end(), T{0});
+          for (size_t t = 0; t < weights.size(); ++t) {
+            T const* shifted = padded.data() + t;
+            const T w = weights[t];
+            for (size_t j = 0; j < len; ++j) {
+              acc[j] += w * shifted[j];
+            }
+          }
+          std::copy(acc.begin(), acc.end(), values);
+        }
+      });
+      continue;
+    }
+
+    //lines of dimension d are strided by inner; a tile is a run of adjacent lines, so each padded row is contiguous
+    const size_t tile = std::max<size_t>(1, std::min(inner, tile_elements / (len + 2 * radius)));
+    const size_t tiles_per_slab = (inner + tile - 1) / tile;
+    parallel_for(outer * tiles_per_slab, nthreads, [&](size_t task) {
+      const size_t slab = task / tiles_per_slab;
+      const size_t first = (task % tiles_per_slab) * tile;
+      const size_t width = std::min(tile, inner - first);
+      T* lines = data + slab * inner * len + first;
+      std::vector<T> padded((len + 2 * radius) * width);
+      correlated_noise_detail::pad_lines(lines, inner, len, width, radius, padded.data());
+
+      std::vector<T> acc(width);
+      for (size_t j = 0; j < len; ++j) {
+        std::fill(acc.begin(), acc.end(), T{0});
+        for (size_t t = 0; t < weights.size(); ++t) {
+          T const* row = padded.data() + (j + t) * width;
+          const T w = weights[t];
+          for (size_t i = 0; i < width; ++i) {
+            acc[i] += w * row[i];
+          }
+        }
+        std::copy(acc.begin(), acc.end(), lines + j * inner);
+      }
+    });
+  }
+  correlated_noise_detail::shift(data, n, offset, tile_elements, nthreads);
+}
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_CORRELATED_NOISE_H */
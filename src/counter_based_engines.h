@@ -0,0 +1,158 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_COUNTER_BASED_ENGINES_H
+#define LIBPRESSIO_ERROR_INJECTOR_COUNTER_BASED_ENGINES_H
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * \file
+ * counter based random number engines
+ *
+ * A counter based engine computes each block of output as a keyed bijection of a 128 bit counter, so the stream can be
+ * advanced to any position in constant time.  This allows any block of a buffer to compute its portion of the stream
+ * directly, see Salmon et al. "Parallel random numbers: as easy as 1, 2, 3" SC'11.
+ */
+
+/**
+ * the Philox4x32-10 bijection
+ */
+struct philox4x32_bijection {
+  static std::array<uint32_t, 4> apply(std::array<uint32_t, 4> ctr, std::array<uint32_t, 4> const& key) {
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; ++round) {
+      if(round != 0) {
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+      uint64_t const p0 = static_cast<uint64_t>(0xD2511F53) * ctr[0];
+      uint64_t const p1 = static_cast<uint64_t>(0xCD9E8D57) * ctr[2];
+      ctr = {
+        static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ k0,
+        static_cast<uint32_t>(p1),
+        static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ k1,
+        static_cast<uint32_t>(p0)
+      };
+    }
+    return ctr;
+  }
+};
+
+/**
+ * the Threefry2x64-20 bijection, each 64 bit output word is returned as two 32 bit outputs
+ */
+struct threefry2x64_bijection {
+  static std::array<uint32_t, 4> apply(std::array<uint32_t, 4> const& ctr, std::array<uint32_t, 4> const& key) {
+    static constexpr unsigned rotations[8] = {16, 42, 12, 31, 16, 32, 24, 21};
+    uint64_t const ks[3] = {
+      join(key[0], key[1]),
+      join(key[2], key[3]),
+      0x1BD11BDAA9FC1A22 ^ join(key[0], key[1]) ^ join(key[2], key[3])
+    };
+    uint64_t x0 = join(ctr[0], ctr[1]) + ks[0];
+    uint64_t x1 = join(ctr[2], ctr[3]) + ks[1];
+    for (unsigned round = 0; round < 20; ++round) {
+      x0 += x1;
+      x1 = (x1 << rotations[round % 8]) | (x1 >> (64 - rotations[round % 8]));
+      x1 ^= x0;
+      if(round % 4 == 3) {
+        unsigned const s = round / 4 + 1;
+        x0 += ks[s % 3];
+        x1 += ks[(s + 1) % 3] + s;
+      }
+    }
+    return {
+      static_cast<uint32_t>(x0), static_cast<uint32_t>(x0 >> 32),
+      static_cast<uint32_t>(x1), static_cast<uint32_t>(x1 >> 32)
+    };
+  }
+
+  private:
+  static uint64_t join(uint32_t lo, uint32_t hi) {
+    return static_cast<uint64_t>(hi) << 32 | lo;
+  }
+};
+
+/**
+ * a random number engine meeting the requirements of RandomNumberEngine built from a counter based bijection
+ *
+ * each application of the bijection produces 4 outputs; the position in the stream is tracked as a 128 bit count of
+ * outputs consumed so discard runs in constant time
+ */
+template <class Bijection>
+class counter_based_engine {
+  public:
+  using result_type = uint32_t;
+  static constexpr unsigned long long default_seed = 20111115u;
+
+  counter_based_engine() { seed(); }
+  explicit counter_based_engine(unsigned long long value) { seed(value); }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return 0xFFFFFFFF; }
+
+  void seed(unsigned long long value = default_seed) {
+    key = {static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32), 0, 0};
+    reset_position();
+  }
+
+  template <class Sseq>
+  typename std::enable_if<!std::is_integral<Sseq>::value>::type seed(Sseq& seq) {
+    seq.generate(key.begin(), key.end());
+    reset_position();
+  }
+
+  result_type operator()() {
+    if(!valid) {
+      block = Bijection::apply({
+          static_cast<uint32_t>(position_lo >> 2 | position_hi << 62),
+          static_cast<uint32_t>((position_lo >> 2 | position_hi << 62) >> 32),
+          static_cast<uint32_t>(position_hi >> 2),
+          static_cast<uint32_t>(position_hi >> 34)
+          }, key);
+      valid = true;
+    }
+    result_type const value = block[position_lo & 3];
+    if(++position_lo == 0) ++position_hi;
+    if((position_lo & 3) == 0) valid = false;
+    return value;
+  }
+
+  void discard(unsigned long long n) {
+    uint64_t const old_lo = position_lo;
+    position_lo += n;
+    if(position_lo < old_lo) ++position_hi;
+    valid = false;
+  }
+
+  bool operator==(counter_based_engine const& rhs) const {
+    return key == rhs.key && position_lo == rhs.position_lo && position_hi == rhs.position_hi;
+  }
+  bool operator!=(counter_based_engine const& rhs) const {
+    return !(*this == rhs);
+  }
+
+  private:
+  void reset_position() {
+    position_lo = 0;
+    position_hi = 0;
+    valid = false;
+  }
+
+  std::array<uint32_t, 4> key{};
+  std::array<uint32_t, 4> block{};
+  uint64_t position_lo = 0, position_hi = 0;
+  bool valid = false;
+};
+
+using philox4x32 = counter_based_engine<philox4x32_bijection>;
+using threefry2x64 = counter_based_engine<threefry2x64_bijection>;
+
+/**
+ * true if Engine can discard outputs in constant time
+ */
+template <class Engine>
+struct has_constant_time_discard: std::false_type {};
+template <class Bijection>
+struct has_constant_time_discard<counter_based_engine<Bijection>>: std::true_type {};
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_COUNTER_BASED_ENGINES_H */
@@ -0,0 +1,121 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_ERROR_STATS_H
+#define LIBPRESSIO_ERROR_INJECTOR_ERROR_STATS_H
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * statistics of the error between original and perturbed buffers, accumulated while the perturbed values are written
+ *
+ * Squared errors are summed in double precision per chunk and the chunk sums are added to the total, so rounding error
+ * grows with the number of chunks rather than elements.  Accumulators of disjoint parts of a buffer are combined with
+ * merge.  Elements that are compared count towards the mean squared error even if their error is zero.
+ */
+struct error_stats {
+  static constexpr size_t chunk_size = 4096;
+
+  uint64_t elements = 0;
+  double sum_squared = 0;
+  double max_abs = 0;
+  double min_value = std::numeric_limits<double>::infinity();
+  double max_value = -std::numeric_limits<double>::infinity();
+
+  /**
+   * compares n original and perturbed values, n should be at most chunk_size
+   */
+  template <class T>
+  void add(T const* original, T const* perturbed, size_t n) {
+    double sum = 0, error = max_abs, lo = min_value, hi = max_value;
+    //selects rather than std::max so the loop vectorizes; NaN is skipped
+    for (size_t i = 0; i < n; ++i) {
+      const double value = static_cast<double>(original[i]);
+      const double diff = static_cast<double>(perturbed[i]) - value;
+      sum += diff * diff;
+      const double abs = std::fabs(diff);
+      error = (error < abs) ? abs : error;
+      lo = (value < lo) ? value : lo;
+      hi = (hi < value) ? value : hi;
+    }
+    sum_squared += sum;
+    max_abs = error;
+    min_value = lo;
+    max_value = hi;
+    elements += n;
+  }
+
+  /**
+   * compares a single element without counting it, for elements already counted by add_range
+   */
+  template <class T>
+  void add_error(T original, T perturbed) {
+    const double diff = static_cast<double>(perturbed) - static_cast<double>(original);
+    sum_squared += diff * diff;
+    max_abs = std::max(max_abs, std::fabs(diff));
+  }
+
+  /**
+   * counts n original values and includes them in the value range
+   */
+  template <class T>
+  void add_range(T const* original, size_t n) {
+    double lo = min_value, hi = max_value;
+    for (size_t i = 0; i < n; ++i) {
+      const double value = static_cast<double>(original[i]);
+      lo = (value < lo) ? value : lo;
+      hi = (hi < value) ? value : hi;
+    }
+    min_value = lo;
+    max_value = hi;
+    elements += n;
+  }
+
+  void merge(error_stats const& other) {
+    elements += other.elements;
+    sum_squared += other.sum_squared;
+    max_abs = std::max(max_abs, other.max_abs);
+    min_value = std::min(min_value, other.min_value);
+    max_value = std::max(max_value, other.max_value);
+  }
+
+  double mse() const {
+    return (elements > 0) ? sum_squared / static_cast<double>(elements) : 0.0;
+  }
+  double rmse() const {
+    return std::sqrt(mse());
+  }
+  /**
+   * \returns the peak signal to noise ratio in dB using the range of the original values, infinite if there is no error
+   */
+  double psnr() const {
+    if(mse() == 0) return std::numeric_limits<double>::infinity();
+    const double range = (min_value <= max_value) ? max_value - min_value : 0.0;
+    return 20 * std::log10(range) - 10 * std::log10(mse());
+  }
+};
+
+/**
+ * writes the output of kernel(in, out, offset, len) for each chunk [src+offset, src+offset+len) of at most chunk_size
+ * elements to dst; if stats is not null each chunk is written to a buffer and compared to src while it is in cache
+ * before it is copied to dst, so dst may be src
+ */
+template <class T, class Kernel>
+void transform_chunks(T const* src, T* dst, size_t n, error_stats* stats, Kernel&& kernel) {
+  if(stats == nullptr) {
+    for (size_t offset = 0; offset < n; offset += error_stats::chunk_size) {
+      kernel(src + offset, dst + offset, offset, std::min(error_stats::chunk_size, n - offset));
+    }
+    return;
+  }
+  std::array<T, error_stats::chunk_size> out;
+  for (size_t offset = 0; offset < n; offset += out.size()) {
+    const size_t len = std::min(out.size(), n - offset);
+    kernel(src + offset, out.data(), offset, len);
+    stats->add(src + offset, out.data(), len);
+    std::copy(out.begin(), out.begin() + len, dst + offset);
+  }
+}
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_ERROR_STATS_H */
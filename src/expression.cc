@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+#include "expression.h"
+
+namespace {
+  using opcode = compiled_expression::opcode;
+  using instruction = compiled_expression::instruction;
+
+  constexpr double pi = 3.141592653589793238462643383279502884;
+  constexpr double e = 2.718281828459045235360287471352662498;
+
+  /*
+   * the arithmetic of each opcode, shared by constant folding, the per row scalar pass, and the per element loops so
+   * all three agree exactly
+   */
+  struct op_add { double operator()(double a, double b) const { return a + b; } };
+  struct op_sub { double operator()(double a, double b) const { return a - b; } };
+  struct op_mul { double operator()(double a, double b) const { return a * b; } };
+  struct op_div { double operator()(double a, double b) const { return a / b; } };
+  struct op_pow { double operator()(double a, double b) const { return std::pow(a, b); } };
+  struct op_atan2 { double operator()(double a, double b) const { return std::atan2(a, b); } };
+  struct op_min { double operator()(double a, double b) const { return (b < a) ? b : a; } };
+  struct op_max { double operator()(double a, double b) const { return (a < b) ? b : a; } };
+  struct op_mod { double operator()(double a, double b) const { return std::fmod(a, b); } };
+  struct op_neg { double operator()(double a) const { return -a; } };
+  struct op_sin { double operator()(double a) const { return std::sin(a); } };
+  struct op_cos { double operator()(double a) const { return std::cos(a); } };
+  struct op_tan { double operator()(double a) const { return std::tan(a); } };
+  struct op_asin { double operator()(double a) const { return std::asin(a); } };
+  struct op_acos { double operator()(double a) const { return std::acos(a); } };
+  struct op_atan { double operator()(double a) const { return std::atan(a); } };
+  struct op_sinh { double operator()(double a) const { return std::sinh(a); } };
+  struct op_cosh { double operator()(double a) const { return std::cosh(a); } };
+  struct op_tanh { double operator()(double a) const { return std::tanh(a); } };
+  struct op_exp { double operator()(double a) const { return std::exp(a); } };
+  struct op_log { double operator()(double a) const { return std::log(a); } };
+  struct op_log10 { double operator()(double a) const { return std::log10(a); } };
+  struct op_sqrt { double operator()(double a) const { return std::sqrt(a); } };
+  struct op_abs { double operator()(double a) const { return std::fabs(a); } };
+  struct op_floor { double operator()(double a) const { return std::floor(a); } };
+  struct op_ceil { double operator()(double a) const { return std::ceil(a); } };
+
+  /**
+   * calls f with the functor implementing op
+   */
+  template <class Function>
+  auto dispatch(opcode op, Function&& f) -> decltype(f(op_add{})) {
+    switch(op) {
+      case opcode::add: return f(op_add{});
+      case opcode::sub: return f(op_sub{});
+      case opcode::mul: return f(op_mul{});
+      case opcode::div: return f(op_div{});
+      case opcode::pow: return f(op_pow{});
+      case opcode::atan2: return f(op_atan2{});
+      case opcode::min: return f(op_min{});
+      case opcode::max: return f(op_max{});
+      case opcode::mod: return f(op_mod{});
+      case opcode::neg: return f(op_neg{});
+      case opcode::sin: return f(op_sin{});
+      case opcode::cos: return f(op_cos{});
+      case opcode::tan: return f(op_tan{});
+      case opcode::asin: return f(op_asin{});
+      case opcode::acos: return f(op_acos{});
+      case opcode::atan: return f(op_atan{});
+      case opcode::sinh: return f(op_sinh{});
+      case opcode::cosh: return f(op_cosh{});
+      case opcode::tanh: return f(op_tanh{});
+      case opcode::exp: return f(op_exp{});
+      case opcode::log: return f(op_log{});
+      case opcode::log10: return f(op_log10{});
+      case opcode::sqrt: return f(op_sqrt{});
+      case opcode::abs: return f(op_abs{});
+      case opcode::floor: return f(op_floor{});
+      case opcode::ceil: return f(op_ceil{});
+      case opcode::constant:
+      case opcode::coordinate:
+        break;
+    }
+    throw std::logic_error("opcode has no arithmetic");
+  }
+
+  bool is_binary(opcode op) {
+    return op >= opcode::add && op <= opcode::mod;
+  }
+
+  /**
+   * the value of an instruction given the scalar values of its operands
+   */
+  struct scalar_op {
+    template <class Op>
+    double operator()(Op op) const { return call(op, 0); }
+
+    template <class Op>
+    auto call(Op op, int) const -> decltype(op(0.0, 0.0)) { return op(a, b); }
+    template <class Op>
+    auto call(Op op, long) const -> decltype(op(0.0)) { return op(a); }
+
+    double a, b;
+  };
+
+  /**
+   * an operand of a per element loop, either a row of values or a value broadcast across the row
+   */
+  struct operand {
+    double const* values;
+    double scalar;
+  };
+
+  /**
+   * evaluates an instruction over a row, written as separate loops for each combination of row and broadcast
+   * operands so each loop vectorizes
+   */
+  struct vector_op {
+    template <class Op>
+    void operator()(Op op) const { call(op, 0); }
+
+    template <class Op>
+    auto call(Op op, int) const -> decltype(op(0.0, 0.0), void()) {
+      if(a.values && b.values) {
+        for (size_t i = 0; i < n; ++i) out[i] = op(a.values[i], b.values[i]);
+      } else if(a.values) {
+        const double bs = b.scalar;
+        for (size_t i = 0; i < n; ++i) out[i] = op(a.values[i], bs);
+      } else {
+        const double as = a.scalar;
+        for (size_t i = 0; i < n; ++i) out[i] = op(as, b.values[i]);
+      }
+    }
+    template <class Op>
+    auto call(Op op, long) const -> decltype(op(0.0), void()) {
+      for (size_t i = 0; i < n; ++i) out[i] = op(a.values[i]);
+    }
+
+    double* out;
+    operand a, b;
+    size_t n;
+  };
+
+  struct function_info {
+    const char* name;
+    opcode op;
+  };
+  const function_info functions[] = {
+    {"sin", opcode::sin}, {"cos", opcode::cos}, {"tan", opcode::tan},
+    {"asin", opcode::asin}, {"acos", opcode::acos}, {"atan", opcode::atan},
+    {"sinh", opcode::sinh}, {"cosh", opcode::cosh}, {"tanh", opcode::tanh},
+    {"exp", opcode::exp}, {"log", opcode::log}, {"log10", opcode::log10},
+    {"sqrt", opcode::sqrt}, {"abs", opcode::abs}, {"floor", opcode::floor}, {"ceil", opcode::ceil},
+    {"pow", opcode::pow}, {"atan2", opcode::atan2}, {"min", opcode::min}, {"max", opcode::max}, {"mod", opcode::mod},
+  };
+}
+
+/**
+ * a recursive descent parser which emits instructions as it parses
+ *
+ * expression := term (('+' | '-') term)*
+ * term       := unary (('*' | '/') unary)*
+ * unary      := ('-' | '+') unary | power
+ * power      := primary ('^' unary)?
+ * primary    := number | name | name '(' expression (',' expression)* ')' | '(' expression ')'
+ */
+class expression_parser {
+  public:
+  expression_parser(compiled_expression& program, std::string const& source, std::vector<size_t> const& dims):
+    program(program), source(source), dims(dims) {}
+
+  uint32_t parse() {
+    const uint32_t result = parse_expression();
+    skip_space();
+    if(pos != source.size()) fail("unexpected character");
+    return result;
+  }
+
+  private:
+  uint32_t parse_expression() {
+    uint32_t lhs = parse_term();
+    while(true) {
+      if(accept('+')) lhs = binary(opcode::add, lhs, parse_term());
+      else if(accept('-')) lhs = binary(opcode::sub, lhs, parse_term());
+      else return lhs;
+    }
+  }
+
+  uint32_t parse_term() {
+    uint32_t lhs = parse_unary();
+    while(true) {
+      if(accept('*')) lhs = binary(opcode::mul, lhs, parse_unary());
+      else if(accept('/')) lhs = binary(opcode::div, lhs, parse_unary());
+      else return lhs;
+    }
+  }
+
+  uint32_t parse_unary() {
+    if(accept('-')) return unary(opcode::neg, parse_unary());
+    if(accept('+')) return parse_unary();
+    return parse_power();
+  }
+
+  uint32_t parse_power() {
+    const uint32_t base = parse_primary();
+    if(accept('^')) return binary(opcode::pow, base, parse_unary());
+    return base;
+  }
+
+  uint32_t parse_primary() {
+    skip_space();
+    if(pos == source.size()) fail("unexpected end of expression");
+    if(accept('(')) {
+      const uint32_t value = parse_expression();
+      expect(')');
+      return value;
+    }
+    const char c = source[pos];
+    if(std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+      const char* begin = source.c_str() + pos;
+      char* end;
+      const double value = std::strtod(begin, &end);
+      if(end == begin) fail("invalid number");
+      pos += end - begin;
+      return constant(value);
+    }
+    if(std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+      const size_t begin = pos;
+      while(pos < source.size() && (std::isalnum(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) ++pos;
+      return parse_name(source.substr(begin, pos - begin), begin);
+    }
+    fail("unexpected character");
+  }
+
+  uint32_t parse_name(std::string const& name, size_t name_pos) {
+    if(accept('(')) {
+      for (auto const& function : functions) {
+        if(name != function.name) continue;
+        const uint32_t a = parse_expression();
+        if(is_binary(function.op)) {
+          expect(',');
+          const uint32_t b = parse_expression();
+          expect(')');
+          return binary(function.op, a, b);
+        }
+        expect(')');
+        return unary(function.op, a);
+      }
+      pos = name_pos;
+      fail("unknown function " + name);
+    }
+    if(name == "pi") return constant(pi);
+    if(name == "e") return constant(e);
+    static const std::string aliases = "xyzw";
+    if(name.size() == 1 && aliases.find(name[0]) != std::string::npos) {
+      return coordinate(aliases.find(name[0]), name_pos);
+    }
+    if(name.size() > 1 && (name[0] == 'x' || name[0] == 'n') &&
+       std::all_of(name.begin() + 1, name.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+      const size_t dim = std::strtoul(name.c_str() + 1, nullptr, 10);
+      if(name[0] == 'x') return coordinate(dim, name_pos);
+      if(dim >= dims.size()) {
+        pos = name_pos;
+        fail("the grid has no dimension " + std::to_string(dim));
+      }
+      return constant(static_cast<double>(dims[dim]));
+    }
+    pos = name_pos;
+    fail("unknown name " + name);
+  }
+
+  uint32_t constant(double value) {
+    return program.emit({opcode::constant, false, 0, 0, value});
+  }
+  uint32_t coordinate(size_t dim, size_t name_pos) {
+    if(dim >= dims.size()) {
+      pos = name_pos;
+      fail("the grid has no dimension " + std::to_string(dim));
+    }
+    return program.emit({opcode::coordinate, dim == 0, static_cast<uint32_t>(dim), 0, 0});
+  }
+  uint32_t unary(opcode op, uint32_t a) {
+    return program.emit({op, false, a, 0, 0});
+  }
+  uint32_t binary(opcode op, uint32_t a, uint32_t b) {
+    return program.emit({op, false, a, b, 0});
+  }
+
+  void skip_space() {
+    while(pos < source.size() && std::isspace(static_cast<unsigned char>(source[pos]))) ++pos;
+  }
+  bool accept(char c) {
+    skip_space();
+    if(pos < source.size() && source[pos] == c) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+  void expect(char c) {
+    if(!accept(c)) fail(std::string("expected '") + c + "'");
+  }
+  [[noreturn]] void fail(std::string const& message) {
+    throw std::invalid_argument(message + " at position " + std::to_string(pos) + " of \"" + source + "\"");
+  }
+
+  compiled_expression& program;
+  std::string const& source;
+  std::vector<size_t> const& dims;
+  size_t pos = 0;
+};
+
+uint32_t compiled_expression::emit(instruction ins) {
+  if(ins.op != opcode::constant && ins.op != opcode::coordinate) {
+    instruction const& a = code[ins.a];
+    instruction const& b = is_binary(ins.op) ? code[ins.b] : a;
+    if(a.op == opcode::constant && b.op == opcode::constant) {
+      ins = {opcode::constant, false, 0, 0, dispatch(ins.op, scalar_op{a.constant, b.constant})};
+    } else {
+      ins.varying = a.varying || b.varying;
+    }
+  }
+  code.push_back(ins);
+  return static_cast<uint32_t>(code.size() - 1);
+}
+
+compiled_expression::compiled_expression(std::string const& source, std::vector<size_t> const& dims) {
+  const uint32_t root = expression_parser(*this, source, dims).parse();
+
+  //drop the instructions folded into constants
+  std::vector<bool> live(code.size(), false);
+  live[root] = true;
+  for (size_t i = code.size(); i-- > 0;) {
+    if(!live[i] || code[i].op == opcode::constant || code[i].op == opcode::coordinate) continue;
+    live[code[i].a] = true;
+    if(is_binary(code[i].op)) live[code[i].b] = true;
+  }
+  std::vector<uint32_t> renumber(code.size());
+  std::vector<instruction> compacted;
+  for (size_t i = 0; i < code.size(); ++i) {
+    if(!live[i]) continue;
+    instruction ins = code[i];
+    if(ins.op != opcode::constant && ins.op != opcode::coordinate) {
+      ins.a = renumber[ins.a];
+      if(is_binary(ins.op)) ins.b = renumber[ins.b];
+    }
+    renumber[i] = static_cast<uint32_t>(compacted.size());
+    compacted.push_back(ins);
+  }
+  code = std::move(compacted);
+  result = renumber[root];
+
+  //assign rows of scratch to varying instructions, reusing a row once its last reader has run
+  std::vector<size_t> last_use(code.size(), 0);
+  for (size_t i = 0; i < code.size(); ++i) {
+    if(code[i].op == opcode::constant || code[i].op == opcode::coordinate) continue;
+    last_use[code[i].a] = i;
+    if(is_binary(code[i].op)) last_use[code[i].b] = i;
+  }
+  last_use[result] = code.size();
+  std::vector<uint32_t> free_slots;
+  vector_slot.assign(code.size(), 0);
+  for (size_t i = 0; i < code.size(); ++i) {
+    instruction const& ins = code[i];
+    if(!ins.varying) continue;
+    if(ins.op != opcode::coordinate) {
+      //elementwise operations may write the row they read, so operands last used here are released first
+      for (uint32_t operand : {ins.a, is_binary(ins.op) ? ins.b : ins.a}) {
+        if(code[operand].varying && last_use[operand] == i &&
+           std::find(free_slots.begin(), free_slots.end(), vector_slot[operand]) == free_slots.end()) {
+          free_slots.push_back(vector_slot[operand]);
+        }
+      }
+    }
+    if(free_slots.empty()) {
+      vector_slot[i] = vector_slots++;
+    } else {
+      vector_slot[i] = free_slots.back();
+      free_slots.pop_back();
+    }
+  }
+}
+
+compiled_expression::workspace compiled_expression::make_workspace() const {
+  workspace work;
+  work.scalars.resize(code.size());
+  work.vectors.resize(static_cast<size_t>(vector_slots) * chunk_size);
+  return work;
+}
+
+void compiled_expression::evaluate(workspace& work, double const* coordinates, size_t n, double* out, bool row_changed) const {
+  double* scalars = work.scalars.data();
+  if(row_changed) {
+    for (size_t i = 0; i < code.size(); ++i) {
+      instruction const& ins = code[i];
+      if(ins.varying) continue;
+      switch(ins.op) {
+        case opcode::constant:
+          scalars[i] = ins.constant;
+          break;
+        case opcode::coordinate:
+          scalars[i] = coordinates[ins.a];
+          break;
+        default:
+          scalars[i] = dispatch(ins.op, scalar_op{scalars[ins.a], is_binary(ins.op) ? scalars[ins.b] : 0.0});
+          break;
+      }
+    }
+  }
+
+  auto row = [&](uint32_t i) { return work.vectors.data() + static_cast<size_t>(vector_slot[i]) * chunk_size; };
+  auto as_operand = [&](uint32_t i) {
+    return code[i].varying ? operand{row(i), 0.0} : operand{nullptr, scalars[i]};
+  };
+  for (size_t i = 0; i < code.size(); ++i) {
+    instruction const& ins = code[i];
+    if(!ins.varying) continue;
+    double* values = row(static_cast<uint32_t>(i));
+    if(ins.op == opcode::coordinate) {
+      const double begin = coordinates[0];
+      for (size_t j = 0; j < n; ++j) values[j] = begin + static_cast<double>(j);
+    } else {
+      dispatch(ins.op, vector_op{values, as_operand(ins.a), is_binary(ins.op) ? as_operand(ins.b) : operand{nullptr, 0.0}, n});
+    }
+  }
+
+  if(code[result].varying) {
+    std::copy(row(result), row(result) + n, out);
+  } else {
+    std::fill(out, out + n, scalars[result]);
+  }
+}
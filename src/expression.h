@@ -0,0 +1,88 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_EXPRESSION_H
+#define LIBPRESSIO_ERROR_INJECTOR_EXPRESSION_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * a small expression language over the coordinates of an N-d grid
+ *
+ * Expressions are built from numbers, the operators + - * / ^ and parentheses, and the names:
+ *
+ * + `x0`, `x1`, ... the index along each dimension, `x`, `y`, `z`, `w` are aliases for `x0` through `x3`;
+ *   dimension 0 varies fastest
+ * + `n0`, `n1`, ... the size of each dimension
+ * + `pi` and `e`
+ * + the functions sin, cos, tan, asin, acos, atan, sinh, cosh, tanh, exp, log, log10, sqrt, abs, floor, ceil, and
+ *   the two argument functions pow, atan2, min, max, and mod
+ *
+ * for example `sin(2*pi*x/n0) + exp(-((x-n0/2)^2 + (y-n1/2)^2)/100) + 0.01*z`
+ */
+
+/**
+ * an expression compiled to a register based bytecode
+ *
+ * Each instruction writes its own register.  Constant subexpressions are folded when compiling, and instructions that
+ * do not depend on `x0` are evaluated once per row, so the per element work is a sequence of tight loops over a row of
+ * `x0` which the compiler vectorizes.
+ */
+class compiled_expression {
+  public:
+  /**
+   * compiles source for a grid with the given dimensions
+   *
+   * \throws std::invalid_argument describing the first syntax error
+   */
+  compiled_expression(std::string const& source, std::vector<size_t> const& dims);
+
+  /**
+   * scratch space for evaluating an expression, each thread needs its own
+   */
+  class workspace {
+    friend compiled_expression;
+    std::vector<double> scalars;
+    std::vector<double> vectors;
+  };
+
+  static constexpr size_t chunk_size = 256;
+
+  /**
+   * evaluates the expression for n <= chunk_size consecutive elements of a row
+   *
+   * \param[in] coordinates the coordinates of the first element, one per dimension
+   * \param[in] n the number of elements, x0 takes values coordinates[0] through coordinates[0]+n-1
+   * \param[out] out the n results
+   * \param[in] row_changed false if only coordinates[0] changed since the last call with this workspace
+   */
+  void evaluate(workspace& work, double const* coordinates, size_t n, double* out, bool row_changed = true) const;
+
+  /**
+   * \returns a workspace sized for this expression
+   */
+  workspace make_workspace() const;
+
+  enum class opcode: uint8_t {
+    constant, coordinate,
+    add, sub, mul, div, pow, atan2, min, max, mod,
+    neg, sin, cos, tan, asin, acos, atan, sinh, cosh, tanh, exp, log, log10, sqrt, abs, floor, ceil,
+  };
+  struct instruction {
+    opcode op;
+    bool varying;
+    uint32_t a, b;
+    double constant;
+  };
+
+  private:
+  friend class expression_parser;
+  uint32_t emit(instruction ins);
+
+  std::vector<instruction> code;
+  std::vector<uint32_t> vector_slot;
+  uint32_t vector_slots = 0;
+  uint32_t result = 0;
+};
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_EXPRESSION_H */
@@ -0,0 +1,53 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_INJECTION_METRICS_H
+#define LIBPRESSIO_ERROR_INJECTOR_INJECTION_METRICS_H
+#include <chrono>
+#include <cstdint>
+
+/**
+ * counters recorded by the injector plugins on every call; times are in milliseconds and describe the most recent
+ * call of each kind
+ */
+struct injection_metrics {
+  double setup_time = 0;
+  double injection_time = 0;
+  double compress_time = 0;
+  double decompress_time = 0;
+  uint64_t elements = 0;
+  uint64_t injections = 0;
+  uint64_t bytes_copied = 0;
+  uint64_t cache_hits = 0;
+  uint64_t cache_errors = 0;
+
+  /**
+   * clears the counters describing a compress call
+   */
+  void reset_compress() {
+    setup_time = 0;
+    injection_time = 0;
+    compress_time = 0;
+    elements = 0;
+    injections = 0;
+    bytes_copied = 0;
+    cache_hits = 0;
+    cache_errors = 0;
+  }
+};
+
+/**
+ * adds the milliseconds elapsed between construction and destruction to elapsed
+ */
+class scoped_timer {
+  public:
+  explicit scoped_timer(double& elapsed): elapsed(elapsed), begin(std::chrono::steady_clock::now()) {}
+  ~scoped_timer() {
+    elapsed += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+  }
+  scoped_timer(scoped_timer const&)=delete;
+  scoped_timer& operator=(scoped_timer const&)=delete;
+
+  private:
+  double& elapsed;
+  std::chrono::steady_clock::time_point begin;
+};
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_INJECTION_METRICS_H */
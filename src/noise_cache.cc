@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "noise_cache.h"
+
+namespace {
+  constexpr char magic[8] = {'L', 'P', 'E', 'I', 'N', 'O', 'I', '1'};
+  constexpr size_t alignment = 64;
+
+  struct header {
+    char magic[8];
+    uint64_t key_length;
+    uint64_t bytes;
+  };
+
+  size_t data_offset(size_t key_length) {
+    const size_t end = sizeof(header) + key_length;
+    return (end + alignment - 1) / alignment * alignment;
+  }
+
+  uint64_t fnv1a(std::string const& key) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (unsigned char c : key) {
+      hash ^= c;
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+}
+
+mapped_noise::mapped_noise(void* mapping, size_t mapping_size, size_t offset):
+  mapping(mapping), mapping_size(mapping_size), offset(offset) {}
+
+mapped_noise::mapped_noise(mapped_noise&& rhs) noexcept:
+  mapping(rhs.mapping), mapping_size(rhs.mapping_size), offset(rhs.offset) {
+  rhs.mapping = nullptr;
+}
+
+mapped_noise& mapped_noise::operator=(mapped_noise&& rhs) noexcept {
+  if(this != &rhs) {
+    if(mapping) munmap(mapping, mapping_size);
+    mapping = rhs.mapping;
+    mapping_size = rhs.mapping_size;
+    offset = rhs.offset;
+    rhs.mapping = nullptr;
+  }
+  return *this;
+}
+
+mapped_noise::~mapped_noise() {
+  if(mapping) munmap(mapping, mapping_size);
+}
+
+std::string noise_cache_path(std::string const& dir, std::string const& key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "noise-%016llx.bin", static_cast<unsigned long long>(fnv1a(key)));
+  if(dir.empty() || dir.back() == '/') return dir + name;
+  return dir + '/' + name;
+}
+
+mapped_noise open_noise_cache(std::string const& path, std::string const& key, size_t bytes) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if(fd == -1) return {};
+  struct stat info;
+  const size_t expected_size = data_offset(key.size()) + bytes;
+  if(fstat(fd, &info) == -1 || static_cast<size_t>(info.st_size) != expected_size) {
+    close(fd);
+    return {};
+  }
+  void* mapping = mmap(nullptr, expected_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapping == MAP_FAILED) return {};
+  mapped_noise noise(mapping, expected_size, data_offset(key.size()));
+
+  header h;
+  std::memcpy(&h, mapping, sizeof(h));
+  if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.key_length != key.size() || h.bytes != bytes ||
+     std::memcmp(static_cast<char const*>(mapping) + sizeof(header), key.data(), key.size()) != 0) {
+    return {};
+  }
+  return noise;
+}
+
+noise_cache_writer::noise_cache_writer(std::string path, std::string tmp_path, void* mapping, size_t mapping_size,
+    size_t offset):
+  path(std::move(path)), tmp_path(std::move(tmp_path)), mapping(mapping), mapping_size(mapping_size), offset(offset) {}
+
+noise_cache_writer::noise_cache_writer(noise_cache_writer&& rhs) noexcept:
+  path(std::move(rhs.path)), tmp_path(std::move(rhs.tmp_path)), mapping(rhs.mapping), mapping_size(rhs.mapping_size),
+  offset(rhs.offset) {
+  rhs.mapping = nullptr;
+}
+
+noise_cache_writer& noise_cache_writer::operator=(noise_cache_writer&& rhs) noexcept {
+  if(this != &rhs) {
+    release();
+    path = std::move(rhs.path);
+    tmp_path = std::move(rhs.tmp_path);
+    mapping = rhs.mapping;
+    mapping_size = rhs.mapping_size;
+    offset = rhs.offset;
+    rhs.mapping = nullptr;
+  }
+  return *this;
+}
+
+noise_cache_writer::~noise_cache_writer() {
+  release();
+}
+
+void noise_cache_writer::release() {
+  if(mapping) {
+    munmap(mapping, mapping_size);
+    mapping = nullptr;
+    std::remove(tmp_path.c_str());
+  }
+}
+
+bool noise_cache_writer::commit() {
+  if(!mapping) return false;
+  munmap(mapping, mapping_size);
+  mapping = nullptr;
+  if(std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+noise_cache_writer create_noise_cache(std::string const& path, std::string const& key, size_t bytes) {
+  std::ostringstream tmp_path;
+  tmp_path << path << ".tmp." << getpid() << '.' << std::this_thread::get_id();
+  const int fd = open(tmp_path.str().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1) return {};
+  const size_t size = data_offset(key.size()) + bytes;
+  void* mapping = MAP_FAILED;
+  if(ftruncate(fd, static_cast<off_t>(size)) == 0) {
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if(mapping == MAP_FAILED) {
+    std::remove(tmp_path.str().c_str());
+    return {};
+  }
+
+  header h;
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.key_length = key.size();
+  h.bytes = bytes;
+  std::memcpy(mapping, &h, sizeof(h));
+  std::memcpy(static_cast<char*>(mapping) + sizeof(header), key.data(), key.size());
+  return noise_cache_writer(path, tmp_path.str(), mapping, size, data_offset(key.size()));
+}
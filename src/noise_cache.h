@@ -0,0 +1,98 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_NOISE_CACHE_H
+#define LIBPRESSIO_ERROR_INJECTOR_NOISE_CACHE_H
+#include <cstddef>
+#include <string>
+
+/**
+ * \file
+ * an on-disk cache of noise buffers
+ *
+ * Each cache file holds one noise buffer and the key it was generated for.  The file starts with an 8 byte magic
+ * number, the length of the key and the size of the buffer as 64 bit integers, and the key; the buffer follows,
+ * aligned to 64 bytes so it can be used directly from a read only memory mapping.
+ */
+
+/**
+ * a read only memory mapping of the buffer of a noise cache file
+ */
+class mapped_noise {
+  public:
+  mapped_noise()=default;
+  mapped_noise(void* mapping, size_t mapping_size, size_t offset);
+  mapped_noise(mapped_noise&& rhs) noexcept;
+  mapped_noise& operator=(mapped_noise&& rhs) noexcept;
+  mapped_noise(mapped_noise const&)=delete;
+  mapped_noise& operator=(mapped_noise const&)=delete;
+  ~mapped_noise();
+
+  /**
+   * \returns true if a cache file was mapped
+   */
+  bool valid() const { return mapping != nullptr; }
+  void const* data() const { return static_cast<char const*>(mapping) + offset; }
+
+  private:
+  void* mapping = nullptr;
+  size_t mapping_size = 0;
+  size_t offset = 0;
+};
+
+/**
+ * a cache file being written through a writable memory mapping
+ *
+ * the file is created under a temporary name and renamed to its path by commit, so concurrent readers never observe a
+ * partial file.  A file that is not committed is removed when the writer is destroyed.
+ */
+class noise_cache_writer {
+  public:
+  noise_cache_writer()=default;
+  noise_cache_writer(std::string path, std::string tmp_path, void* mapping, size_t mapping_size, size_t offset);
+  noise_cache_writer(noise_cache_writer&& rhs) noexcept;
+  noise_cache_writer& operator=(noise_cache_writer&& rhs) noexcept;
+  noise_cache_writer(noise_cache_writer const&)=delete;
+  noise_cache_writer& operator=(noise_cache_writer const&)=delete;
+  ~noise_cache_writer();
+
+  /**
+   * \returns true if a cache file was created and not yet committed
+   */
+  bool valid() const { return mapping != nullptr; }
+  void* data() const { return static_cast<char*>(mapping) + offset; }
+
+  /**
+   * unmaps the buffer and moves the file to its path, data() is invalidated
+   *
+   * \returns false if the file could not be moved, in which case it is removed
+   */
+  bool commit();
+
+  private:
+  void release();
+
+  std::string path, tmp_path;
+  void* mapping = nullptr;
+  size_t mapping_size = 0;
+  size_t offset = 0;
+};
+
+/**
+ * \returns the path of the cache file for key in directory dir
+ */
+std::string noise_cache_path(std::string const& dir, std::string const& key);
+
+/**
+ * maps the cache file at path
+ *
+ * \returns an invalid mapping if the file does not exist, is malformed, or was written for a different key or size
+ */
+mapped_noise open_noise_cache(std::string const& path, std::string const& key, size_t bytes);
+
+/**
+ * creates the cache file at path for a buffer of bytes bytes, which the caller fills through the writer before
+ * committing it
+ *
+ * \returns an invalid writer if the file cannot be created, for example if the directory does not exist
+ */
+noise_cache_writer create_noise_cache(std::string const& path, std::string const& key, size_t bytes);
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_NOISE_CACHE_H */
@@ -0,0 +1,55 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_PARALLEL_FOR_H
+#define LIBPRESSIO_ERROR_INJECTOR_PARALLEL_FOR_H
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * calls f(i) for each i in [0, n) using up to nthreads threads
+ *
+ * indices are handed out dynamically so the assignment of work to threads is unspecified; f must only depend on i for
+ * results to be independent of nthreads.  The first exception thrown by f is rethrown on the calling thread after all
+ * threads have finished.
+ */
+template <class Function>
+void parallel_for(size_t n, unsigned int nthreads, Function&& f) {
+  nthreads = static_cast<unsigned int>(std::min<size_t>(std::max(nthreads, 1u), n));
+  if(nthreads <= 1) {
+    for (size_t i = 0; i < n; ++i) {
+      f(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]{
+    try {
+      for (size_t i = next++; i < n; i = next++) {
+        f(i);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(error_mutex);
+      if(!error) error = std::current_exception();
+      next = n;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(nthreads - 1);
+  for (unsigned int i = 1; i < nthreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if(error) std::rethrow_exception(error);
+}
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_PARALLEL_FOR_H */
@@ -0,0 +1,122 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_PIPELINE_H
+#define LIBPRESSIO_ERROR_INJECTOR_PIPELINE_H
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * a first in first out queue of at most capacity items shared between threads
+ *
+ * once closed, push fails and pop returns the remaining items before failing, so closing wakes every waiting thread
+ */
+template <class T>
+class bounded_queue {
+  public:
+  explicit bounded_queue(size_t capacity): capacity(capacity) {}
+
+  /**
+   * waits for space and appends value
+   * \returns false if the queue was closed
+   */
+  bool push(T value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [this]{ return closed || items.size() < capacity; });
+    if(closed) return false;
+    items.push_back(std::move(value));
+    not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * waits for an item and removes it into value
+   * \returns false if the queue was closed and is empty
+   */
+  bool pop(T& value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [this]{ return closed || !items.empty(); });
+    if(items.empty()) return false;
+    value = std::move(items.front());
+    items.pop_front();
+    not_full.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> guard(mutex);
+    closed = true;
+    not_full.notify_all();
+    not_empty.notify_all();
+  }
+
+  private:
+  size_t capacity;
+  bool closed = false;
+  std::deque<T> items;
+  std::mutex mutex;
+  std::condition_variable not_full, not_empty;
+};
+
+/**
+ * calls produce(i, slot) for each i in [0, n) in order on the calling thread and consume(i, slot) in the same order on
+ * a second thread, so producing item i+1 overlaps consuming item i
+ *
+ * Items are handed over through a queue of depth items and identified by the slot in [0, depth + 2) that holds them,
+ * which is not reused until the item is consumed, so at most depth + 2 slots are in use.  If produce or consume returns
+ * false both stop early.  The first exception thrown by either is rethrown on the calling thread after the second
+ * thread has finished.
+ */
+template <class Produce, class Consume>
+void pipeline(size_t n, size_t depth, Produce&& produce, Consume&& consume) {
+  depth = std::max<size_t>(depth, 1);
+  const size_t slots = depth + 2;
+  bounded_queue<std::pair<size_t, size_t>> ready(depth);
+  bounded_queue<size_t> free_slots(slots);
+  for (size_t slot = 0; slot < slots; ++slot) {
+    free_slots.push(slot);
+  }
+
+  std::atomic<bool> stop{false};
+  std::exception_ptr consume_error;
+  std::thread consumer([&]{
+    try {
+      for (std::pair<size_t, size_t> item; !stop && ready.pop(item);) {
+        if(!consume(item.first, item.second)) break;
+        free_slots.push(item.second);
+      }
+    } catch (...) {
+      consume_error = std::current_exception();
+    }
+    //stops the producer if this thread stopped early, and is harmless once every item is consumed
+    stop = true;
+    ready.close();
+    free_slots.close();
+  });
+
+  std::exception_ptr produce_error;
+  try {
+    for (size_t i = 0; i < n && !stop; ++i) {
+      size_t slot;
+      if(!free_slots.pop(slot)) break;
+      if(!produce(i, slot)) {
+        stop = true;
+        break;
+      }
+      if(!ready.push(std::make_pair(i, slot))) break;
+    }
+  } catch (...) {
+    produce_error = std::current_exception();
+    stop = true;
+  }
+  ready.close();
+  consumer.join();
+  if(produce_error) std::rethrow_exception(produce_error);
+  if(consume_error) std::rethrow_exception(consume_error);
+}
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_PIPELINE_H */
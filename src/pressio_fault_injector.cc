@@ -9,6 +9,10 @@
 #include <sstream>
 #include <algorithm>
 #include <type_traits>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <atomic>
 #include "pressio_data.h"
 #include "pressio_compressor.h"
 #include "libpressio_ext/cpp/data.h"
@@ -18,6 +22,8 @@
 #include "libpressio_ext/cpp/domain_manager.h"
 #include "std_compat/optional.h"
 #include "std_compat/memory.h"
+#include "parallel_for.h"
+#include "injection_metrics.h"
 
 enum class bit_action {
   flip = 1,
@@ -47,6 +53,264 @@ bit_action from_string(std::string const& s) {
   }
 }
 
+enum class fault_model {
+  single,
+  burst,
+  multi_bit,
+  stuck_at,
+  element_bit
+};
+std::vector<std::string> fault_model_names() {
+  return {"single", "burst", "multi_bit", "stuck_at", "element_bit"};
+}
+std::string to_string(fault_model const& model) {
+  return fault_model_names().at(static_cast<size_t>(model));
+}
+fault_model fault_model_from_string(std::string const& s) {
+  auto names = fault_model_names();
+  auto it = std::find(names.begin(), names.end(), s);
+  if(it == names.end()) {
+    throw std::invalid_argument(s);
+  }
+  return static_cast<fault_model>(std::distance(names.begin(), it));
+}
+
+namespace {
+  /**
+   * applies a bit_action to a byte or word, resolved at compile time so injection loops do not branch on the action
+   *
+   * save(ptr, n) is called before bytes [ptr, ptr+n) are modified, see patch_recorder
+   */
+  template <bit_action Action> struct apply_action;
+  template <> struct apply_action<bit_action::flip> {
+    template <class Word>
+    void apply(Word& word, Word mask) const { word ^= mask; }
+    void save(uint8_t const*, size_t) const {}
+  };
+  template <> struct apply_action<bit_action::set> {
+    template <class Word>
+    void apply(Word& word, Word mask) const { word |= mask; }
+    void save(uint8_t const*, size_t) const {}
+  };
+  template <> struct apply_action<bit_action::unset> {
+    template <class Word>
+    void apply(Word& word, Word mask) const { word &= static_cast<Word>(~mask); }
+    void save(uint8_t const*, size_t) const {}
+  };
+
+  /**
+   * the original contents of bytes modified by an injection, restoring them in reverse order undoes the injection
+   */
+  using patch_list = std::vector<std::pair<size_t, uint8_t>>;
+
+  /**
+   * wraps an action to record a patch_list of the bytes it modifies
+   */
+  template <class Action>
+  struct patch_recorder {
+    template <class Word>
+    void apply(Word& word, Word mask) const { action.apply(word, mask); }
+    void save(uint8_t const* ptr, size_t n) const {
+      for (size_t i = 0; i < n; ++i) {
+        patches->emplace_back(static_cast<size_t>(ptr - base) + i, ptr[i]);
+      }
+    }
+    Action action;
+    uint8_t const* base;
+    patch_list* patches;
+  };
+
+  void restore(uint8_t* bytes, patch_list& patches) {
+    for (auto it = patches.rbegin(); it != patches.rend(); ++it) {
+      bytes[it->first] = it->second;
+    }
+    patches.clear();
+  }
+
+  /**
+   * computes the maximum absolute difference from a reference buffer of the same type, propagating NaN
+   */
+  struct max_abs_error {
+    template <class T>
+    double operator()(T const* begin, T const* end) {
+      T const* ref = static_cast<T const*>(reference);
+      double error = 0;
+      for (; begin != end; ++begin, ++ref) {
+        const double diff = std::abs(static_cast<double>(*begin) - static_cast<double>(*ref));
+        if(!(diff <= error)) error = diff;
+      }
+      return error;
+    }
+    void const* reference;
+  };
+
+  /**
+   * applies Action with a 64 bit mask to the up to 8 bytes starting at bytes[offset]; bit k of the mask corresponds to
+   * bit k%8 of bytes[offset + k/8]
+   */
+  template <class Action>
+  void apply_word_mask(uint8_t* bytes, size_t len, size_t offset, uint64_t mask, Action const& action) {
+    action.save(bytes + offset, std::min(sizeof(uint64_t), len - offset));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if(offset + sizeof(uint64_t) <= len) {
+      uint64_t word;
+      std::memcpy(&word, bytes + offset, sizeof(word));
+      action.apply(word, mask);
+      std::memcpy(bytes + offset, &word, sizeof(word));
+      return;
+    }
+#endif
+    for (size_t i = 0; i < sizeof(uint64_t) && offset + i < len; ++i) {
+      action.apply(bytes[offset + i], static_cast<uint8_t>(mask >> (8 * i)));
+    }
+  }
+
+  /**
+   * applies Action to length consecutive bits starting at bit start, one 64 bit window at a time
+   */
+  template <class Action>
+  void apply_burst(uint8_t* bytes, size_t len, uint64_t start, uint64_t length, Action const& action) {
+    while(length > 0) {
+      const unsigned shift = start % 8;
+      const uint64_t n = std::min<uint64_t>(length, 64 - shift);
+      const uint64_t mask = ((n == 64) ? ~uint64_t{0} : ((uint64_t{1} << n) - 1)) << shift;
+      apply_word_mask(bytes, len, start / 8, mask, action);
+      start += n;
+      length -= n;
+    }
+  }
+
+  /**
+   * chooses min(k, available) distinct bits of a 64 bit word
+   */
+  template <class Generator>
+  uint64_t random_word_mask(unsigned int k, unsigned int available, Generator& gen) {
+    k = std::min(k, available);
+    uint64_t mask = 0;
+    for (unsigned int j = available - k; j < available; ++j) {
+      const unsigned int t = std::uniform_int_distribution<unsigned int>(0, j)(gen);
+      const uint64_t bit = uint64_t{1} << t;
+      mask |= (mask & bit) ? (uint64_t{1} << j) : bit;
+    }
+    return mask;
+  }
+
+  /**
+   * calls f with the apply_action specialization for action
+   */
+  template <class Function>
+  void dispatch_action(bit_action action, Function&& f) {
+    switch(action) {
+      case bit_action::flip:
+        return f(apply_action<bit_action::flip>{});
+      case bit_action::set:
+        return f(apply_action<bit_action::set>{});
+      case bit_action::unset:
+        return f(apply_action<bit_action::unset>{});
+    }
+    throw std::logic_error("unhanded bit_action");
+  }
+
+  /**
+   * applies Action to each bit of [bytes, bytes+len) independently with probability rate
+   *
+   * the gaps between affected bits are drawn from a geometric distribution so positions are produced in ascending
+   * order and the cost scales with the number of affected bits rather than len
+   *
+   * \returns the number of affected bits
+   */
+  template <class Action, class Generator>
+  uint64_t inject_bit_errors(uint8_t* bytes, size_t len, double rate, Generator& gen, Action const& action) {
+    const uint64_t bits = static_cast<uint64_t>(len) * 8;
+    if(rate >= 1.0) {
+      action.save(bytes, len);
+      for (uint64_t bit = 0; bit < bits; ++bit) {
+        action.apply(bytes[bit >> 3], static_cast<uint8_t>(1u << (bit & 7)));
+      }
+      return bits;
+    }
+    std::geometric_distribution<uint64_t> gap(rate);
+    uint64_t affected = 0;
+    for (uint64_t bit = 0; ; ++bit) {
+      const uint64_t skip = gap(gen);
+      if(skip >= bits - bit) break;
+      bit += skip;
+      action.save(bytes + (bit >> 3), 1);
+      action.apply(bytes[bit >> 3], static_cast<uint8_t>(1u << (bit & 7)));
+      ++affected;
+    }
+    return affected;
+  }
+
+  //size of the independently seeded segments used by the bit error rate mode
+  constexpr size_t segment_bytes = 1 << 20;
+
+  /**
+   * the bit positions targeted by the element_bit fault model for one element type
+   *
+   * masks[k] selects bit k of an element within the little endian word starting at the element, and weights[k] is the
+   * relative probability that bit k is chosen
+   */
+  struct bit_targets {
+    size_t element_bytes = 1;
+    std::vector<uint64_t> masks;
+    std::vector<double> weights;
+  };
+
+  /**
+   * \returns the first and one past the last bit of an IEEE-754 field of a float or double
+   */
+  std::pair<unsigned int, unsigned int> ieee_field(pressio_dtype dtype, std::string const& field) {
+    const bool is_double = dtype == pressio_double_dtype;
+    const unsigned int mantissa_bits = is_double ? 52 : 23;
+    const unsigned int bits = is_double ? 64 : 32;
+    if(field == "mantissa") return {0, mantissa_bits};
+    if(field == "exponent") return {mantissa_bits, bits - 1};
+    if(field == "sign") return {bits - 1, bits};
+    throw std::invalid_argument("invalid bit field " + field);
+  }
+
+  /**
+   * computes the targets for elements of dtype from per bit weights, or if there are none, from named IEEE-754 fields
+   *
+   * \throws std::invalid_argument if the weights or fields do not apply to dtype
+   */
+  bit_targets make_bit_targets(pressio_dtype dtype, std::vector<double> const& bit_weights, std::vector<std::string> const& fields) {
+    bit_targets targets;
+    targets.element_bytes = pressio_dtype_size(dtype);
+    if(targets.element_bytes == 0 || targets.element_bytes > sizeof(uint64_t)) {
+      throw std::invalid_argument("element_bit requires elements of 1 to 8 bytes");
+    }
+    const unsigned int bits = static_cast<unsigned int>(targets.element_bytes * 8);
+    for (unsigned int k = 0; k < bits; ++k) {
+      targets.masks.push_back(uint64_t{1} << k);
+    }
+    targets.weights.assign(bits, 0.0);
+    if(!bit_weights.empty()) {
+      if(bit_weights.size() > bits) {
+        throw std::invalid_argument("bit_weights has more entries than the " + std::to_string(bits) + " bits of an element");
+      }
+      for (size_t k = 0; k < bit_weights.size(); ++k) {
+        if(!(bit_weights[k] >= 0)) throw std::invalid_argument("bit_weights must be non-negative");
+        targets.weights[k] = bit_weights[k];
+      }
+    } else if(!fields.empty()) {
+      if(dtype != pressio_float_dtype && dtype != pressio_double_dtype) {
+        throw std::invalid_argument("bit_fields requires float or double elements");
+      }
+      for (auto const& field : fields) {
+        auto range = ieee_field(dtype, field);
+        std::fill(targets.weights.begin() + range.first, targets.weights.begin() + range.second, 1.0);
+      }
+    } else {
+      std::fill(targets.weights.begin(), targets.weights.end(), 1.0);
+    }
+    if(std::none_of(targets.weights.begin(), targets.weights.end(), [](double w) { return w > 0; })) {
+      throw std::invalid_argument("at least one bit must have a positive weight");
+    }
+    return targets;
+  }
+}
 
 class fault_injector_plugin: public libpressio_compressor_plugin {
 
@@ -54,6 +318,18 @@ class fault_injector_plugin: public libpressio_compressor_plugin {
     struct pressio_options options = pressio_options();
     set(options, "fault_injector:seed", seed);
     set(options, "fault_injector:injections", injections);
+    set(options, "fault_injector:bit_error_rate", bit_error_rate);
+    set(options, "fault_injector:nthreads", nthreads);
+    set(options, "fault_injector:fault_model", to_string(model));
+    set(options, "fault_injector:burst_length", burst_length);
+    set(options, "fault_injector:bits_per_fault", bits_per_fault);
+    set(options, "fault_injector:stuck_at_mask", stuck_at_mask);
+    set(options, "fault_injector:region_start", region_start);
+    set(options, "fault_injector:region_length", region_length);
+    set(options, "fault_injector:element_dtype", element_dtype);
+    set(options, "fault_injector:bit_weights", bit_weights);
+    set(options, "fault_injector:bit_fields", bit_fields);
+    set(options, "fault_injector:trials", trials);
     set(options, "fault_injector:injection_mode", mode);
     set_type(options, "fault_injector:injection_mode_str", pressio_option_charptr_type);
     set_meta(options, "fault_injector:compressor", compressor_name, compressor);
@@ -66,6 +342,28 @@ class fault_injector_plugin: public libpressio_compressor_plugin {
     set(options, "pressio:description", "injects single bit errors of specified distribution");
     set(options, "fault_injector:seed", "random number seed");
     set(options, "fault_injector:injections", "the number of injections to make");
+    set(options, "fault_injector:bit_error_rate", "if non-zero, affect each bit independently with this probability instead of making a fixed number of injections; only used by the single fault model");
+    set(options, "fault_injector:nthreads", "number of threads used to inject errors for bit_error_rate; results do not depend on the number of threads");
+    set(options, "fault_injector:fault_model", "the fault model: single independent bits, burst of consecutive bits, multi_bit upsets within a 64 bit word, stuck_at bits across a region, or element_bit flips of a chosen bit of a random element");
+    set(options, "fault_injector:fault_models", "available fault models");
+    set(options, "fault_injector:burst_length", "number of consecutive bits affected by each burst fault");
+    set(options, "fault_injector:bits_per_fault", "number of distinct bits affected within the 64 bit word chosen by each multi_bit fault");
+    set(options, "fault_injector:stuck_at_mask", "mask applied with injection_mode to every 64 bit word of the region for stuck_at faults, e.g. set for stuck-at-1 and unset for stuck-at-0");
+    set(options, "fault_injector:region_start", "first byte of the region affected by stuck_at faults");
+    set(options, "fault_injector:region_length", "length in bytes of the region affected by stuck_at faults, 0 extends it to the end of the buffer");
+    set(options, "fault_injector:element_dtype", "the pressio_dtype of the elements targeted by element_bit faults, defaults to the dtype of the compressed buffer, e.g. the input dtype with the noop compressor");
+    set(options, "fault_injector:bit_weights", "relative probability that element_bit faults choose each bit of an element, least significant bit first; missing entries are 0");
+    set(options, "fault_injector:bit_fields", "if bit_weights is not set, element_bit faults choose uniformly among the bits of these IEEE-754 fields of float or double elements: sign, exponent, mantissa; defaults to every bit");
+    set(options, "fault_injector:setup_time", "time in milliseconds spent making the compressed buffer readable and preserving it for a campaign in the last compress call");
+    set(options, "fault_injector:injection_time", "time in milliseconds spent injecting faults in the last compress call");
+    set(options, "fault_injector:compress_time", "time in milliseconds spent in the child compressor in the last compress call");
+    set(options, "fault_injector:decompress_time", "time in milliseconds spent in the child compressor in the last decompress call");
+    set(options, "fault_injector:bytes", "size in bytes of the compressed buffer faults were injected into in the last compress call");
+    set(options, "fault_injector:faults_applied", "number of faults applied in the last compress call: affected bits for bit_error_rate, affected words for stuck_at, and injections otherwise");
+    set(options, "fault_injector:bytes_copied", "number of bytes copied to make the compressed buffer readable and to run the campaign in the last compress call");
+    set(options, "fault_injector:trials", "if non-zero, after compressing once, decompress this many faulty variants of the compressed buffer in parallel on nthreads; trial t uses seed+t so it matches a single compress with that seed");
+    set(options, "fault_injector:campaign_status", "the error code of decompressing each trial of the last campaign");
+    set(options, "fault_injector:campaign_max_error", "the maximum absolute error of each trial of the last campaign, NaN if decompression failed or changed the shape of the data");
     set(options, "fault_injector:injection_mode", "the method of performing injections");
     set(options, "fault_injector:injection_mode_str", "human interpretable mode");
     return options;
@@ -75,13 +373,17 @@ class fault_injector_plugin: public libpressio_compressor_plugin {
     pressio_options options;
     set(options, "pressio:thread_safe", pressio_thread_safety_multiple);
     set(options, "fault_injector:injection_mode_str", std::vector<std::string>{"set", "unset", "flip"});
+    set(options, "fault_injector:fault_models", fault_model_names());
     
-        std::vector<std::string> invalidations {"fault_injector:seed", "fault_injector:injections", "fault_injector:injection_mode", "fault_injector:injection_mode_str"}; 
+        std::vector<std::string> invalidations {"fault_injector:seed", "fault_injector:injections", "fault_injector:injection_mode", "fault_injector:injection_mode_str", "fault_injector:bit_error_rate", "fault_injector:fault_model", "fault_injector:burst_length", "fault_injector:bits_per_fault", "fault_injector:stuck_at_mask", "fault_injector:region_start", "fault_injector:region_length", "fault_injector:element_dtype", "fault_injector:bit_weights", "fault_injector:bit_fields"}; 
+        std::vector<std::string> runtime_invalidations = invalidations;
+        runtime_invalidations.emplace_back("fault_injector:nthreads");
+        runtime_invalidations.emplace_back("fault_injector:trials");
         std::vector<pressio_configurable const*> invalidation_children {&*compressor}; 
         
         set(options, "predictors:error_dependent", get_accumulate_configuration("predictors:error_dependent", invalidation_children, invalidations));
         set(options, "predictors:error_agnostic", get_accumulate_configuration("predictors:error_agnostic", invalidation_children, invalidations));
-        set(options, "predictors:runtime", get_accumulate_configuration("predictors:runtime", invalidation_children, invalidations));
+        set(options, "predictors:runtime", get_accumulate_configuration("predictors:runtime", invalidation_children, runtime_invalidations));
 
     return options;
   };
@@ -90,6 +392,31 @@ class fault_injector_plugin: public libpressio_compressor_plugin {
     get_meta(options, "fault_injector:compressor", compressor_plugins(), compressor_name, compressor);
     get(options, "fault_injector:seed", &seed);
     get(options, "fault_injector:injections", &injections);
+    double rate;
+    if(get(options, "fault_injector:bit_error_rate", &rate) == pressio_options_key_set) {
+      if(!(rate >= 0.0 && rate <= 1.0)) {
+        return set_error(2, "bit_error_rate must be in [0, 1]");
+      }
+      bit_error_rate = rate;
+    }
+    get(options, "fault_injector:nthreads", &nthreads);
+    std::string model_str;
+    if(get(options, "fault_injector:fault_model", &model_str) == pressio_options_key_set) {
+      try {
+        model = fault_model_from_string(model_str);
+      } catch(std::invalid_argument&) {
+        return set_error(1, "invalid fault_model " + model_str);
+      }
+    }
+    get(options, "fault_injector:burst_length", &burst_length);
+    get(options, "fault_injector:bits_per_fault", &bits_per_fault);
+    get(options, "fault_injector:stuck_at_mask", &stuck_at_mask);
+    get(options, "fault_injector:region_start", &region_start);
+    get(options, "fault_injector:region_length", &region_length);
+    get(options, "fault_injector:element_dtype", &element_dtype);
+    get(options, "fault_injector:bit_weights", &bit_weights);
+    get(options, "fault_injector:bit_fields", &bit_fields);
+    get(options, "fault_injector:trials", &trials);
     get(options, "fault_injector:injection_mode", &mode);
     std::string mode_str;
     if(get(options, "fault_injector:injection_mode_str", &mode_str) == pressio_options_key_set) {
@@ -103,40 +430,212 @@ class fault_injector_plugin: public libpressio_compressor_plugin {
   }
 
   int 	compress_impl (const pressio_data *input, struct pressio_data *output) override {
-    int ret = compressor->compress(input, output);
-    *output = domain_manager().make_readable(domain_plugins().build("malloc"), std::move(*output));
+    metrics.reset_compress();
+    int ret;
+    {
+      scoped_timer timer(metrics.compress_time);
+      ret = compressor->compress(input, output);
+    }
+    pressio_data pristine;
+    {
+      scoped_timer timer(metrics.setup_time);
+      void const* compressed = output->data();
+      *output = domain_manager().make_readable(domain_plugins().build("malloc"), std::move(*output));
+      if(output->data() != compressed) metrics.bytes_copied += output->size_in_bytes();
+      if(trials > 0) {
+        pristine = pressio_data::clone(*output);
+        metrics.bytes_copied += pristine.size_in_bytes();
+      }
+    }
     uint8_t* bytes = static_cast<uint8_t*>(output->data());
     size_t len = output->size_in_bytes();
+    metrics.elements = len;
 
-    std::mt19937_64 gen;
-    gen.seed(seed.value_or(time(nullptr)));
-    std::uniform_int_distribution<size_t> len_dist(0, len);
-    std::uniform_int_distribution<uint8_t> bit_dist(0, 7);
-
-    for (unsigned int i = 0; i < injections; ++i) {
-      uint8_t mask = (1<<bit_dist(gen));
-      uint8_t& byte = bytes[len_dist(gen)];
-
-      switch(bit_action(mode)) {
-        case bit_action::flip:
-          byte ^= mask;
-          break;
-        case bit_action::set:
-          byte |= mask;
-          break;
-        case bit_action::unset:
-          byte &= (~mask);
-          break;
+    if(model == fault_model::element_bit) {
+      try {
+        targets = make_bit_targets(element_dtype ? static_cast<pressio_dtype>(*element_dtype) : output->dtype(),
+            bit_weights.to_vector<double>(), bit_fields);
+      } catch (std::invalid_argument const& e) {
+        return set_error(5, e.what());
       }
     }
 
+    const unsigned int gen_seed = seed.value_or(time(nullptr));
+    try {
+    scoped_timer timer(metrics.injection_time);
+    dispatch_action(bit_action(mode), [&](auto action) {
+      metrics.injections = inject_faults(bytes, len, gen_seed, action, nthreads);
+    });
+    } catch (std::logic_error const&) {
+      return set_error(3, "invalid injection_mode " + std::to_string(mode));
+    }
+
+    if(trials > 0 && ret == 0) {
+      return run_campaign(*input, pristine, gen_seed);
+    }
     return ret;
   };
 
+  /**
+   * applies the configured fault model to [bytes, bytes+len) using gen_seed
+   *
+   * \returns the number of faults applied: affected bits for a bit error rate, affected words for stuck_at, and
+   * injections otherwise
+   */
+  template <class Action>
+  uint64_t inject_faults(uint8_t* bytes, size_t len, unsigned int gen_seed, Action const& action, unsigned int threads) {
+    if(model != fault_model::single) {
+      return inject_structured_faults(bytes, len, gen_seed, action);
+    } else if(bit_error_rate > 0) {
+      const size_t segments = (len + segment_bytes - 1) / segment_bytes;
+      std::atomic<uint64_t> affected{0};
+      parallel_for(segments, threads, [&](size_t i) {
+        std::seed_seq seq{gen_seed, static_cast<unsigned int>(i), static_cast<unsigned int>(static_cast<uint64_t>(i) >> 32)};
+        std::mt19937_64 gen(seq);
+        const size_t offset = i * segment_bytes;
+        affected += inject_bit_errors(bytes + offset, std::min(segment_bytes, len - offset), bit_error_rate, gen, action);
+      });
+      return affected;
+    } else if(len > 0) {
+      std::mt19937_64 gen;
+      gen.seed(gen_seed);
+      std::uniform_int_distribution<size_t> len_dist(0, len - 1);
+      std::uniform_int_distribution<uint8_t> bit_dist(0, 7);
+      for (unsigned int i = 0; i < injections; ++i) {
+        uint8_t mask = (1<<bit_dist(gen));
+        uint8_t& byte = bytes[len_dist(gen)];
+        action.save(&byte, 1);
+        action.apply(byte, mask);
+      }
+      return injections;
+    }
+    return 0;
+  }
+
+  /**
+   * decompresses trials faulty variants of the pristine compressed buffer, trial t using seed gen_seed + t
+   *
+   * the compressed buffer is reused across trials: each thread keeps one working copy and restores only the bytes an
+   * injection modified before the next trial
+   */
+  int run_campaign(pressio_data const& input, pressio_data const& pristine, unsigned int gen_seed) {
+    pressio_data reference = domain_manager().make_readable(domain_plugins().build("malloc"), input);
+    campaign_status = pressio_data::owning(pressio_int32_dtype, {trials});
+    campaign_max_error = pressio_data::owning(pressio_double_dtype, {trials});
+    int32_t* status = static_cast<int32_t*>(campaign_status.data());
+    double* max_error = static_cast<double*>(campaign_max_error.data());
+
+    const size_t groups = std::min<size_t>(std::max(nthreads, 1u), trials);
+    std::atomic<uint64_t> copied{0};
+    try {
+    parallel_for(groups, nthreads, [&](size_t group) {
+      pressio_data working = pressio_data::clone(pristine);
+      copied += working.size_in_bytes();
+      uint8_t* bytes = static_cast<uint8_t*>(working.data());
+      const size_t len = working.size_in_bytes();
+      pressio_compressor child = compressor->clone();
+      patch_list patches;
+      for (size_t trial = group; trial < trials; trial += groups) {
+        dispatch_action(bit_action(mode), [&](auto action) {
+          patch_recorder<decltype(action)> recorder{action, bytes, &patches};
+          inject_faults(bytes, len, gen_seed + static_cast<unsigned int>(trial), recorder, 1);
+        });
+        pressio_data decompressed = pressio_data::owning(reference.dtype(), reference.dimensions());
+        status[trial] = child->decompress(&working, &decompressed);
+        if(status[trial] == 0 && decompressed.dtype() == reference.dtype() && decompressed.num_elements() == reference.num_elements()) {
+          max_error[trial] = pressio_data_for_each<double>(decompressed, max_abs_error{reference.data()});
+        } else {
+          max_error[trial] = std::nan("");
+        }
+        restore(bytes, patches);
+      }
+    });
+    } catch (std::exception const& e) {
+      return set_error(4, std::string("campaign failed: ") + e.what());
+    }
+    metrics.bytes_copied += copied;
+    return 0;
+  }
+
    int 	decompress_impl (const pressio_data *input, struct pressio_data *output) override {
+     metrics.decompress_time = 0;
+     scoped_timer timer(metrics.decompress_time);
      return compressor->decompress(input, output);
    }
 
+  /**
+   * applies the burst, multi_bit, and stuck_at fault models with word wide masks
+   */
+  template <class Action>
+  uint64_t inject_structured_faults(uint8_t* bytes, size_t len, unsigned int gen_seed, Action const& action) {
+    if(len == 0) return 0;
+    std::mt19937_64 gen;
+    gen.seed(gen_seed);
+    const uint64_t bits = static_cast<uint64_t>(len) * 8;
+    switch(model) {
+      case fault_model::burst:
+        {
+          const uint64_t length = std::min<uint64_t>(std::max(burst_length, 1u), bits);
+          std::uniform_int_distribution<uint64_t> start_dist(0, bits - length);
+          for (unsigned int i = 0; i < injections; ++i) {
+            apply_burst(bytes, len, start_dist(gen), length, action);
+          }
+        }
+        return injections;
+      case fault_model::multi_bit:
+        {
+          const size_t words = (len + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+          std::uniform_int_distribution<size_t> word_dist(0, words - 1);
+          for (unsigned int i = 0; i < injections; ++i) {
+            const size_t offset = word_dist(gen) * sizeof(uint64_t);
+            const unsigned int available = static_cast<unsigned int>(std::min<size_t>(len - offset, sizeof(uint64_t)) * 8);
+            apply_word_mask(bytes, len, offset, random_word_mask(bits_per_fault, available, gen), action);
+          }
+        }
+        return injections;
+      case fault_model::element_bit:
+        {
+          const size_t elements = len / targets.element_bytes;
+          if(elements == 0) return 0;
+          std::uniform_int_distribution<size_t> element_dist(0, elements - 1);
+          std::discrete_distribution<size_t> bit_dist(targets.weights.begin(), targets.weights.end());
+          for (unsigned int i = 0; i < injections; ++i) {
+            const size_t offset = element_dist(gen) * targets.element_bytes;
+            apply_word_mask(bytes, len, offset, targets.masks[bit_dist(gen)], action);
+          }
+        }
+        return injections;
+      case fault_model::stuck_at:
+        {
+          const size_t begin = std::min<uint64_t>(region_start, len);
+          const size_t end = (region_length == 0) ? len : std::min<uint64_t>(len, begin + region_length);
+          for (size_t offset = begin; offset < end; offset += sizeof(uint64_t)) {
+            apply_word_mask(bytes, end, offset, stuck_at_mask, action);
+          }
+          return (end - begin + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        }
+      case fault_model::single:
+        break;
+    }
+    return 0;
+  }
+
+  struct pressio_options get_metrics_results_impl() const override {
+    pressio_options options = compressor->get_metrics_results();
+    set(options, "fault_injector:setup_time", metrics.setup_time);
+    set(options, "fault_injector:injection_time", metrics.injection_time);
+    set(options, "fault_injector:compress_time", metrics.compress_time);
+    set(options, "fault_injector:decompress_time", metrics.decompress_time);
+    set(options, "fault_injector:bytes", metrics.elements);
+    set(options, "fault_injector:faults_applied", metrics.injections);
+    set(options, "fault_injector:bytes_copied", metrics.bytes_copied);
+    if(trials > 0) {
+      set(options, "fault_injector:campaign_status", campaign_status);
+      set(options, "fault_injector:campaign_max_error", campaign_max_error);
+    }
+    return options;
+  }
+
   public:
 
   int	major_version () const override {
@@ -165,6 +664,21 @@ class fault_injector_plugin: public libpressio_compressor_plugin {
   std::string compressor_name = "noop";
   compat::optional<unsigned int> seed;
   unsigned int injections = 1;
+  double bit_error_rate = 0;
+  unsigned int nthreads = 1;
+  fault_model model = fault_model::single;
+  unsigned int burst_length = 8;
+  unsigned int bits_per_fault = 2;
+  uint64_t stuck_at_mask = 1;
+  uint64_t region_start = 0;
+  uint64_t region_length = 0;
+  compat::optional<int32_t> element_dtype;
+  pressio_data bit_weights;
+  std::vector<std::string> bit_fields;
+  bit_targets targets;
+  unsigned int trials = 0;
+  pressio_data campaign_status, campaign_max_error;
+  injection_metrics metrics;
   unsigned int mode = (unsigned int)bit_action::flip;
   pressio_compressor compressor = compressor_plugins().build("noop");
 };
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "pressio_data.h"
+#include "libpressio_ext/cpp/data.h"
+#include "libpressio_ext/cpp/io.h"
+#include "libpressio_ext/cpp/options.h"
+#include "libpressio_ext/cpp/pressio.h"
+#include "std_compat/memory.h"
+#include "expression.h"
+#include "parallel_for.h"
+
+namespace {
+  /**
+   * writes the value of an expression at each point of the grid to the buffer passed to operator()
+   *
+   * the grid is split into rows along dimension 0 and groups of rows are evaluated in parallel
+   */
+  struct evaluate_function {
+    template <class T>
+    int operator()(T* begin, T* end) {
+      const size_t n = std::distance(begin, end);
+      if(n == 0) return 0;
+      const size_t row_length = dims.front();
+      const size_t rows = n / row_length;
+      const size_t rows_per_task = std::max<size_t>(1, min_task_elements / row_length);
+      const size_t tasks = (rows + rows_per_task - 1) / rows_per_task;
+
+      parallel_for(tasks, nthreads, [&](size_t task) {
+        auto work = expression.make_workspace();
+        std::vector<double> coordinates(dims.size(), 0.0);
+        std::vector<double> values(compiled_expression::chunk_size);
+        const size_t first_row = task * rows_per_task;
+        const size_t last_row = std::min(rows, first_row + rows_per_task);
+
+        //the coordinates of first_row along the outer dimensions
+        size_t index = first_row;
+        for (size_t d = 1; d < dims.size(); ++d) {
+          coordinates[d] = static_cast<double>(index % dims[d]);
+          index /= dims[d];
+        }
+
+        for (size_t row = first_row; row < last_row; ++row) {
+          T* out = begin + row * row_length;
+          for (size_t x = 0; x < row_length; x += compiled_expression::chunk_size) {
+            const size_t len = std::min(compiled_expression::chunk_size, row_length - x);
+            coordinates[0] = static_cast<double>(x);
+            expression.evaluate(work, coordinates.data(), len, values.data(), x == 0);
+            for (size_t i = 0; i < len; ++i) {
+              out[x + i] = static_cast<T>(values[i]);
+            }
+          }
+          //advance the outer coordinates like an odometer
+          for (size_t d = 1; d < dims.size(); ++d) {
+            coordinates[d] += 1;
+            if(coordinates[d] < static_cast<double>(dims[d])) break;
+            coordinates[d] = 0;
+          }
+        }
+      });
+      return 0;
+    }
+
+    static constexpr size_t min_task_elements = 1 << 16;
+    compiled_expression const& expression;
+    std::vector<size_t> const& dims;
+    unsigned int nthreads;
+  };
+}
+
+class generate_data_from_function_plugin: public libpressio_io_plugin {
+  public:
+  pressio_data* read_impl(pressio_data* data) override {
+    pressio_data result;
+    if(data != nullptr && data->has_data()) {
+      result = std::move(*data);
+    } else if(data != nullptr && data->num_dimensions() > 0) {
+      result = pressio_data::owning(data->dtype(), data->dimensions());
+    } else if(dims.num_elements() > 0) {
+      result = pressio_data::owning(static_cast<pressio_dtype>(dtype), dims.to_vector<size_t>());
+    } else {
+      set_error(1, "the dimensions to generate must be provided by the template or generate_data_from_function:dims");
+      return nullptr;
+    }
+
+    try {
+      std::vector<size_t> grid = result.dimensions();
+      if(grid.empty()) grid.push_back(result.num_elements());
+      const compiled_expression compiled(expression, grid);
+      if(result.num_elements() > 0) {
+        pressio_data_for_each<int>(result, evaluate_function{compiled, grid, nthreads});
+      }
+    } catch (std::invalid_argument const& e) {
+      set_error(2, e.what());
+      return nullptr;
+    }
+    return new pressio_data(std::move(result));
+  }
+
+  int write_impl(const pressio_data*) override{
+    return set_error(3, "generate_data_from_function does not support writing");
+  }
+
+  struct pressio_options get_configuration_impl() const override{
+    pressio_options options;
+    set(options, "pressio:thread_safe", pressio_thread_safety_multiple);
+    return options;
+  }
+
+  int set_options_impl(struct pressio_options const& options) override{
+    std::string tmp_expression;
+    if(get(options, "generate_data_from_function:expression", &tmp_expression) == pressio_options_key_set) {
+      //check the syntax now so errors are reported when configuring, names are checked against the grid when reading
+      try {
+        compiled_expression(tmp_expression, std::vector<size_t>(max_dims, 1));
+      } catch (std::invalid_argument const& e) {
+        return set_error(2, e.what());
+      }
+      expression = std::move(tmp_expression);
+    }
+    get(options, "generate_data_from_function:dtype", &dtype);
+    get(options, "generate_data_from_function:dims", &dims);
+    get(options, "generate_data_from_function:nthreads", &nthreads);
+    return 0;
+  }
+
+  struct pressio_options get_options_impl() const override{
+    pressio_options options;
+    set(options, "generate_data_from_function:expression", expression);
+    set(options, "generate_data_from_function:dtype", dtype);
+    set(options, "generate_data_from_function:dims", dims);
+    set(options, "generate_data_from_function:nthreads", nthreads);
+    return options;
+  }
+
+  struct pressio_options get_documentation_impl() const override{
+    pressio_options options;
+    set(options, "pressio:description", "generates buffers by evaluating an expression at each point of the grid when read; the dtype and dimensions of the template passed to read are used if provided");
+    set(options, "generate_data_from_function:expression", "the expression to evaluate, using + - * / ^, x0 x1 ... (or x y z w) for the index along each dimension with x0 varying fastest, n0 n1 ... for the size of each dimension, pi, e, and the functions sin cos tan asin acos atan sinh cosh tanh exp log log10 sqrt abs floor ceil pow atan2 min max mod");
+    set(options, "generate_data_from_function:dtype", "the pressio_dtype to generate when no template is passed to read");
+    set(options, "generate_data_from_function:dims", "the dimensions to generate when no template is passed to read");
+    set(options, "generate_data_from_function:nthreads", "number of threads used to generate data");
+    return options;
+  }
+
+  int major_version() const override {
+    return 0;
+  }
+  int minor_version() const override {
+    return 0;
+  }
+  int patch_version() const override {
+    return 0;
+  }
+  const char* version() const override {
+    return "0.0.0";
+  }
+  const char* prefix() const noexcept override {
+    return "generate_data_from_function";
+  }
+
+  std::shared_ptr<libpressio_io_plugin> clone() override {
+    return compat::make_unique<generate_data_from_function_plugin>(*this);
+  }
+
+  private:
+  static constexpr size_t max_dims = 64;
+  std::string expression = "0";
+  int32_t dtype = pressio_double_dtype;
+  pressio_data dims;
+  unsigned int nthreads = 1;
+};
+
+static pressio_register io_generate_data_from_function_plugin(io_plugins(), "generate_data_from_function", [](){ return compat::make_unique<generate_data_from_function_plugin>(); });
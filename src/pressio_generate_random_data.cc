@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <time.h>
+#include <type_traits>
+#include <vector>
+#include "pressio_data.h"
+#include "libpressio_ext/cpp/data.h"
+#include "libpressio_ext/cpp/io.h"
+#include "libpressio_ext/cpp/options.h"
+#include "libpressio_ext/cpp/pressio.h"
+#include "std_compat/optional.h"
+#include "std_compat/memory.h"
+#include "random_distributions.h"
+#include "block_streams.h"
+
+namespace {
+  /**
+   * \returns the distribution used when dist_name is not set, whose default arguments of 0 and 1 give uniform values in
+   * [0, 1) for floating point types and the integers 0 and 1 otherwise
+   */
+  template <class T>
+  std::string default_distribution() {
+    return std::is_floating_point<T>::value ? "uniform_real_distribution" : "uniform_int_distribution";
+  }
+
+  /**
+   * fills the buffer passed to operator() with samples from the configured distribution
+   */
+  struct generate_random {
+    template <class T>
+    int operator()(T* begin, T* end) {
+      const std::string name = dist_name.empty() ? default_distribution<T>() : dist_name;
+      auto dist = get_distribution_registry<T>().build(name);
+      if(!dist) {
+        throw std::runtime_error("invalid distribution " + name + " for the dtype generated");
+      }
+      dist->configure(dist_args);
+      const size_t n = std::distance(begin, end);
+      const size_t block = (block_size == 0) ? std::max<size_t>(n, 1) : block_size;
+      for_each_block(n, block, nthreads, gen, *dist, seed, 0,
+          [begin](size_t offset, size_t len, polymorphic_generator& block_gen, polymorphic_distribution<T>& block_dist) {
+        block_dist.fill(begin + offset, begin + offset + len, block_gen);
+      });
+      return 0;
+    }
+
+    polymorphic_generator& gen;
+    std::string const& dist_name;
+    std::vector<double> dist_args;
+    unsigned int seed;
+    size_t block_size;
+    unsigned int nthreads;
+  };
+}
+
+class generate_random_data_plugin: public libpressio_io_plugin {
+  public:
+  pressio_data* read_impl(pressio_data* data) override {
+    pressio_data result;
+    if(data != nullptr && data->has_data()) {
+      result = std::move(*data);
+    } else if(data != nullptr && data->num_dimensions() > 0) {
+      result = pressio_data::owning(data->dtype(), data->dimensions());
+    } else if(dims.num_elements() > 0) {
+      result = pressio_data::owning(static_cast<pressio_dtype>(dtype), dims.to_vector<size_t>());
+    } else {
+      set_error(1, "the dimensions to generate must be provided by the template or generate_random_data:dims");
+      return nullptr;
+    }
+
+    auto gen = generator_registry().build(gen_name);
+    if(!gen) {
+      set_error(2, "invalid generator " + gen_name);
+      return nullptr;
+    }
+    try {
+      pressio_data_for_each<int>(result, generate_random{*gen, dist_name, dist_args.to_vector<double>(),
+          seed.value_or(time(nullptr)), block_size, nthreads});
+    } catch (std::invalid_argument const& e) {
+      const std::string name = dist_name.empty() ? "the default distribution" : dist_name;
+      set_error(1, "invalid generate_random_data:dist_args for " + name + ", " + std::to_string(dist_args.num_elements()) +
+          " arguments were passed but " + e.what());
+      return nullptr;
+    } catch (std::runtime_error const& e) {
+      set_error(2, e.what());
+      return nullptr;
+    }
+    return new pressio_data(std::move(result));
+  }
+
+  int write_impl(const pressio_data*) override{
+    return set_error(3, "generate_random_data does not support writing");
+  }
+
+  struct pressio_options get_configuration_impl() const override{
+    pressio_options options;
+    set(options, "pressio:thread_safe", pressio_thread_safety_multiple);
+    return options;
+  }
+
+  int set_options_impl(struct pressio_options const& options) override{
+    get(options, "generate_random_data:seed", &seed);
+    std::string tmp_name;
+    if(get(options, "generate_random_data:dist_name", &tmp_name) == pressio_options_key_set) {
+      if(get_distribution_registry<float>().contains(tmp_name) || get_distribution_registry<uint64_t>().contains(tmp_name)) {
+        dist_name = std::move(tmp_name);
+      }
+    }
+    if(get(options, "generate_random_data:gen_name", &tmp_name) == pressio_options_key_set) {
+      if(generator_registry().contains(tmp_name)) {
+        gen_name = std::move(tmp_name);
+      }
+    }
+    get(options, "generate_random_data:dist_args", &dist_args);
+    get(options, "generate_random_data:dtype", &dtype);
+    get(options, "generate_random_data:dims", &dims);
+    get(options, "generate_random_data:block_size", &block_size);
+    get(options, "generate_random_data:nthreads", &nthreads);
+    return 0;
+  }
+
+  struct pressio_options get_options_impl() const override{
+    pressio_options options;
+    set(options, "generate_random_data:seed", seed);
+    set(options, "generate_random_data:dist_name", dist_name);
+    set(options, "generate_random_data:gen_name", gen_name);
+    set(options, "generate_random_data:dist_args", dist_args);
+    set(options, "generate_random_data:dtype", dtype);
+    set(options, "generate_random_data:dims", dims);
+    set(options, "generate_random_data:block_size", block_size);
+    set(options, "generate_random_data:nthreads", nthreads);
+    return options;
+  }
+
+  struct pressio_options get_documentation_impl() const override{
+    pressio_options options;
+    set(options, "pressio:description", "generates buffers of random data when read; the dtype and dimensions of the template passed to read are used if provided");
+    set(options, "generate_random_data:seed", "random seed to use");
+    set(options, "generate_random_data:dist_name", "name of the distribution to use, by default uniform_real_distribution for floating point dtypes and uniform_int_distribution for integer dtypes");
+    set(options, "generate_random_data:gen_name", "name of the random number generator to use");
+    set(options, "generate_random_data:dist_args", "the distribution arguments, by default 0 and 1 which generates uniform data in [0, 1) for floating point dtypes and 0 or 1 for integer dtypes with the default distribution; distributions taking a single argument need it set");
+    set(options, "generate_random_data:dtype", "the pressio_dtype to generate when no template is passed to read");
+    set(options, "generate_random_data:dims", "the dimensions to generate when no template is passed to read");
+    set(options, "generate_random_data:block_size", "number of elements in each independently seeded block, 0 uses a single stream; the data generated for a seed matches the errors random_error_injector adds with the same settings");
+    set(options, "generate_random_data:nthreads", "number of threads used to generate data");
+    return options;
+  }
+
+  int major_version() const override {
+    return 0;
+  }
+  int minor_version() const override {
+    return 0;
+  }
+  int patch_version() const override {
+    return 0;
+  }
+  const char* version() const override {
+    return "0.0.0";
+  }
+  const char* prefix() const noexcept override {
+    return "generate_random_data";
+  }
+
+  std::shared_ptr<libpressio_io_plugin> clone() override {
+    return compat::make_unique<generate_random_data_plugin>(*this);
+  }
+
+  private:
+  compat::optional<unsigned int> seed;
+  //empty selects default_distribution for the dtype generated
+  std::string dist_name, gen_name = "mt19937_64";
+  pressio_data dist_args{0.0, 1.0};
+  int32_t dtype = pressio_double_dtype;
+  pressio_data dims;
+  uint64_t block_size = 1 << 20;
+  unsigned int nthreads = 1;
+};
+
+static pressio_register io_generate_random_data_plugin(io_plugins(), "generate_random_data", [](){ return compat::make_unique<generate_random_data_plugin>(); });
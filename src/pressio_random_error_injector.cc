@@ -8,6 +8,15 @@
 #include <sstream>
 #include <algorithm>
 #include <type_traits>
+#include <unordered_set>
+#include <tuple>
+#include <atomic>
+#include <limits>
+#include <array>
+#include <ios>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
 #include "pressio_data.h"
 #include "pressio_compressor.h"
 #include "libpressio_ext/cpp/data.h"
@@ -18,11 +27,67 @@
 #include "std_compat/optional.h"
 #include "std_compat/memory.h"
 #include "random_distributions.h"
+#include "block_streams.h"
+#include "injection_metrics.h"
+#include "noise_cache.h"
+#include "correlated_noise.h"
+#include "region.h"
+#include "scratch_pool.h"
+#include "pipeline.h"
+#include "surrogate_compression.h"
+#include "error_stats.h"
 
 extern "C" 
 void libpressio_register_error_injector() {
 }
 
+/**
+ * how a surrogate for a lossy compressor reconstructs each element, none injects noise instead
+ */
+enum class surrogate_mode {
+  none,
+  quantize,
+  predict,
+  truncate
+};
+std::vector<std::string> surrogate_mode_names() {
+  return {"none", "quantize", "predict", "truncate"};
+}
+std::string to_string(surrogate_mode const& mode) {
+  return surrogate_mode_names().at(static_cast<size_t>(mode));
+}
+surrogate_mode surrogate_mode_from_string(std::string const& s) {
+  auto names = surrogate_mode_names();
+  auto it = std::find(names.begin(), names.end(), s);
+  if(it == names.end()) {
+    throw std::invalid_argument(s);
+  }
+  return static_cast<surrogate_mode>(std::distance(names.begin(), it));
+}
+
+/**
+ * how noise is scaled before it is added to each element
+ */
+enum class relative_mode {
+  absolute,
+  range,
+  value
+};
+std::vector<std::string> relative_mode_names() {
+  return {"absolute", "range", "value"};
+}
+std::string to_string(relative_mode const& mode) {
+  return relative_mode_names().at(static_cast<size_t>(mode));
+}
+relative_mode relative_mode_from_string(std::string const& s) {
+  auto names = relative_mode_names();
+  auto it = std::find(names.begin(), names.end(), s);
+  if(it == names.end()) {
+    throw std::invalid_argument(s);
+  }
+  return static_cast<relative_mode>(std::distance(names.begin(), it));
+}
+
 namespace {
   template <class Registry>
   std::vector<std::string> plugin_names(Registry const& plugins) {
@@ -34,40 +99,830 @@ namespace {
 }
 
 
-  struct inject_error {
-    inject_error( pressio_data& dist_args,
-          compat::optional<unsigned int>& seed,
-          std::string& gen_name,
-          std::string& dist_name
-        ): dist_args(dist_args), seed(seed), gen_name(gen_name), dist_name(dist_name)  {}
+  /**
+   * the settings of random_error_injector that determine which errors are injected
+   */
+  struct injection_config {
+    std::string dist_name="uniform_real_distribution", gen_name="mt19937_64";
+    pressio_data dist_args;
+    compat::optional<unsigned int> seed;
+    uint64_t block_size = 1 << 20;
+    unsigned int nthreads = 1;
+    double probability = 1.0;
+    compat::optional<uint64_t> count;
+    int32_t in_place = 0;
+    int32_t continue_stream = 0;
+    std::string noise_cache_dir;
+    uint64_t stream_chunk_size = 0;
+    unsigned int pipeline_depth = 0;
+    std::string stream_input_file, stream_output_file;
+    relative_mode relative = relative_mode::absolute;
+    pressio_data correlation_length;
+    pressio_data roi_start, roi_count, roi_stride, roi_mask;
+    surrogate_mode surrogate = surrogate_mode::none;
+    double error_bound = 1e-4;
+    int32_t compute_error_stats = 0;
+    //identifies the generator, distribution, and arguments, set by make_snapshot
+    std::string state_key;
+
+    /**
+     * \returns true if noise is correlated along any dimension
+     */
+    bool correlated() const {
+      auto lengths = correlation_length.to_vector<double>();
+      return std::any_of(lengths.begin(), lengths.end(), [](double length) { return length > 0; });
+    }
+
+    /**
+     * \returns true if only a region of interest is perturbed
+     */
+    bool has_region() const {
+      return roi_start.num_elements() > 0 || roi_count.num_elements() > 0 || roi_stride.num_elements() > 0 ||
+        roi_mask.num_elements() > 0;
+    }
+  };
+
+  template <class T>
+  T magnitude(T value, std::true_type /*is_signed*/) {
+    return (value < T{0}) ? static_cast<T>(-value) : value;
+  }
+  template <class T>
+  T magnitude(T value, std::false_type /*is_signed*/) {
+    return value;
+  }
+
+  /**
+   * adds noise to elements according to a relative_mode
+   *
+   * range scaled noise is multiplied by the range of the data, value scaled noise by the magnitude of each element;
+   * integers are scaled in double precision
+   */
+  template <class T>
+  struct noise_scale {
+    using scale_type = typename std::conditional<std::is_floating_point<T>::value, T, double>::type;
+
+    T apply(T value, T noise) const {
+      switch(mode) {
+        case relative_mode::range:
+          return static_cast<T>(value + range * noise);
+        case relative_mode::value:
+          return static_cast<T>(value + static_cast<scale_type>(magnitude(value, std::is_signed<T>{})) * noise);
+        case relative_mode::absolute:
+          break;
+      }
+      return static_cast<T>(value + noise);
+    }
+
+    /**
+     * dst[i] = apply(src[i], noise[i]) for i in [0, n), dst may be src
+     */
+    template <class N>
+    void apply(T const* src, N const* __restrict noise, T* dst, size_t n) const {
+      switch(mode) {
+        case relative_mode::range:
+          {
+            const scale_type r = range;
+            for (size_t i = 0; i < n; ++i) dst[i] = static_cast<T>(src[i] + r * noise[i]);
+          }
+          return;
+        case relative_mode::value:
+          for (size_t i = 0; i < n; ++i) {
+            dst[i] = static_cast<T>(src[i] + static_cast<scale_type>(magnitude(src[i], std::is_signed<T>{})) * noise[i]);
+          }
+          return;
+        case relative_mode::absolute:
+          break;
+      }
+      for (size_t i = 0; i < n; ++i) dst[i] = static_cast<T>(src[i] + noise[i]);
+    }
+
+    relative_mode mode;
+    scale_type range;
+  };
 
+  /**
+   * builds the region selecting the non-zero elements of the buffer passed to operator()
+   */
+  struct make_mask_region {
     template <class T>
-    int operator()(T* begin, T* end) {
-      auto gen = generator_registry().build(gen_name);
+    region operator()(T const* begin, T const* end) const {
+      return region::mask(begin, std::distance(begin, end));
+    }
+  };
+
+  /**
+   * computes the minimum and maximum of the buffer passed to operator() in a single pass over blocks on nthreads
+   * threads; NaNs are ignored
+   */
+  struct find_range {
+    template <class T>
+    std::pair<double, double> operator()(T const* begin, T const* end) const {
+      const size_t n = std::distance(begin, end);
+      const size_t blocks = (n + block - 1) / block;
+      std::vector<std::pair<T, T>> ranges(blocks);
+      parallel_for(blocks, nthreads, [&](size_t i) {
+        T const* block_begin = begin + i * block;
+        const size_t len = std::min(block, n - i * block);
+        T lo = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+        T hi = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+        //written as selects rather than std::min so NaN is skipped and the loop vectorizes to min and max instructions
+        for (size_t j = 0; j < len; ++j) {
+          lo = (block_begin[j] < lo) ? block_begin[j] : lo;
+          hi = (hi < block_begin[j]) ? block_begin[j] : hi;
+        }
+        ranges[i] = {lo, hi};
+      });
+      std::pair<double, double> range{std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+      for (auto const& r : ranges) {
+        range.first = std::min(range.first, static_cast<double>(r.first));
+        range.second = std::max(range.second, static_cast<double>(r.second));
+      }
+      return range;
+    }
+
+    size_t block;
+    unsigned int nthreads;
+  };
+
+  /**
+   * \returns max - min of range, or 0 if the range is empty
+   */
+  double range_width(std::pair<double, double> const& range) {
+    return (range.first <= range.second) ? range.second - range.first : 0.0;
+  }
+
+
+  /**
+   * the generator and distributions built for one generator, distribution, and distribution arguments
+   *
+   * the distribution for each dtype is built and configured the first time that dtype is injected.  The generator is
+   * only used as a prototype for generator_for_block so its state never changes.
+   */
+  class injection_state {
+    public:
+    explicit injection_state(std::string key): key(std::move(key)) {}
+
+    polymorphic_generator& generator(injection_config const& config) {
       if(!gen) {
-        throw std::runtime_error("invalid generator " + gen_name);
+        gen = generator_registry().build(config.gen_name);
+        if(!gen) {
+          throw std::runtime_error("invalid generator " + config.gen_name);
+        }
       }
-      auto gen_seed = std::seed_seq{seed.value_or(time(nullptr))};
-      gen->seed(gen_seed);
-      auto dist = get_distribution_registry<T>().build(dist_name);
+      return *gen;
+    }
+
+    template <class T>
+    polymorphic_distribution<T>& distribution(injection_config const& config) {
+      auto& dist = std::get<std::unique_ptr<polymorphic_distribution<T>>>(dists);
       if(!dist) {
-        throw std::runtime_error("invalid distribution " + dist_name);
+        auto built = get_distribution_registry<T>().build(config.dist_name);
+        if(!built) {
+          throw std::runtime_error("invalid distribution " + config.dist_name);
+        }
+        built->configure(config.dist_args.to_vector<double>());
+        dist = std::move(built);
       }
-      dist->configure(dist_args.to_vector<double>());
+      return *dist;
+    }
+
+    std::string const key;
+
+    private:
+    using distributions = std::tuple<
+      std::unique_ptr<polymorphic_distribution<float>>,
+      std::unique_ptr<polymorphic_distribution<double>>,
+      std::unique_ptr<polymorphic_distribution<int8_t>>,
+      std::unique_ptr<polymorphic_distribution<int16_t>>,
+      std::unique_ptr<polymorphic_distribution<int32_t>>,
+      std::unique_ptr<polymorphic_distribution<int64_t>>,
+      std::unique_ptr<polymorphic_distribution<uint8_t>>,
+      std::unique_ptr<polymorphic_distribution<uint16_t>>,
+      std::unique_ptr<polymorphic_distribution<uint32_t>>,
+      std::unique_ptr<polymorphic_distribution<uint64_t>>,
+      std::unique_ptr<polymorphic_distribution<bool>>
+      >;
+    std::unique_ptr<polymorphic_generator> gen;
+    distributions dists;
+  };
 
-           
-      while(begin != end) {
-        *begin += (*dist)(*gen);
-        begin++;
+  /**
+   * \returns the injection_state for config owned by the calling thread, building it on first use
+   *
+   * States are pooled per thread and shared by every plugin on the thread with the same generator, distribution, and
+   * arguments, so clones and repeated calls reuse them without locking while threads never share mutable state.  A
+   * state is only used within a single inject call, so evicting the least recently used state past a small limit is
+   * safe even when injectors are nested.
+   */
+  injection_state& thread_injection_state(injection_config const& config) {
+    constexpr size_t max_states = 8;
+    static thread_local std::vector<std::unique_ptr<injection_state>> states;
+    auto it = std::find_if(states.begin(), states.end(),
+        [&config](std::unique_ptr<injection_state> const& state) { return state->key == config.state_key; });
+    if(it == states.end()) {
+      if(states.size() >= max_states) states.pop_back();
+      states.push_back(compat::make_unique<injection_state>(config.state_key));
+      it = states.end() - 1;
+    }
+    std::rotate(states.begin(), it, it + 1);
+    return *states.front();
+  }
+
+  /**
+   * \returns an immutable snapshot of config to share between a plugin and its clones
+   */
+  std::shared_ptr<const injection_config> make_snapshot(injection_config config) {
+    std::ostringstream key;
+    key << std::hexfloat << config.gen_name << '\0' << config.dist_name << '\0';
+    for (double arg : config.dist_args.to_vector<double>()) {
+      key << arg << ',';
+    }
+    config.state_key = key.str();
+    return std::make_shared<const injection_config>(std::move(config));
+  }
+
+  /**
+   * the position of a plugin in its random stream
+   *
+   * When continue_stream is set, each call starts at the block after the last block used by the previous call so
+   * successive calls see one stream.
+   */
+  class injection_stream {
+    public:
+    /**
+     * starts the stream over from block 0
+     */
+    void restart() {
+      stream_seed.reset();
+      next_block = 0;
+    }
+
+    /**
+     * fixes the seed of a compress call, so every injection of the call uses the same seed even if the call is split
+     * into several injections and the clock ticks between them
+     *
+     * without a configured seed, reseeding streams use the current time on each call while continuing streams fix it on
+     * first use
+     */
+    void begin_call(injection_config const& config) {
+      if(config.seed) {
+        call_seed = *config.seed;
+      } else if(!config.continue_stream) {
+        call_seed = static_cast<unsigned int>(time(nullptr));
+      } else {
+        if(!stream_seed) stream_seed = static_cast<unsigned int>(time(nullptr));
+        call_seed = *stream_seed;
       }
-      return 0;
     }
+
+    /**
+     * \returns the seed fixed by begin_call
+     */
+    unsigned int seed() const {
+      return call_seed;
+    }
+
+    /**
+     * \returns the index of the first block of this call in the stream
+     */
+    size_t first_block(injection_config const& config) const {
+      return config.continue_stream ? next_block : 0;
+    }
+
+    /**
+     * records that a call used blocks blocks of the stream
+     */
+    void advance(injection_config const& config, size_t blocks) {
+      if(config.continue_stream) next_block += blocks;
+    }
+
     private:
-    pressio_data& dist_args;
-    compat::optional<unsigned int>& seed;
-    std::string& gen_name;
-    std::string& dist_name;
+    compat::optional<unsigned int> stream_seed;
+    unsigned int call_seed = 0;
+    size_t next_block = 0;
   };
+
+  /**
+   * chooses min(k, n) distinct indices in [0, n) uniformly at random using Floyd's algorithm
+   *
+   * \returns the indices in ascending order
+   */
+  std::vector<size_t> sample_indices(size_t n, size_t k, polymorphic_generator& gen) {
+    k = std::min(k, n);
+    std::unordered_set<size_t> chosen;
+    chosen.reserve(k);
+    for (size_t j = n - k; j < n; ++j) {
+      const size_t t = std::uniform_int_distribution<size_t>(0, j)(gen);
+      if(!chosen.insert(t).second) {
+        chosen.insert(j);
+      }
+    }
+    std::vector<size_t> indices(chosen.begin(), chosen.end());
+    std::sort(indices.begin(), indices.end());
+    return indices;
+  }
+
+  /**
+   * where a streamed slab lies within the rows of dimension 0 of the whole input, so the predict surrogate continues
+   * rows that are split across slabs
+   */
+  struct slab_rows {
+    //the length of dimension 0 of the whole input and the position of the slab within its row
+    size_t length, offset;
+    predict_carry carry;
+  };
+
+  /**
+   * injects errors into the buffer passed to operator(); if src is not null the buffer is first filled from src as part
+   * of the same pass, otherwise the buffer is modified in place
+   *
+   * the buffer starts at block first_block of the stream; operator() returns the number of blocks used
+   */
+  struct inject_error {
+    inject_error(injection_config const& config, injection_stream const& stream, injection_metrics& metrics, void const* src,
+        size_t first_block, std::string const& cache_key, compat::optional<double> const& range,
+        std::vector<size_t> const& dims, region const* roi, error_stats* stats, slab_rows* rows):
+      config(config), stream(stream), metrics(metrics), src(src), first_block(first_block), cache_key(cache_key), range(range),
+      dims(dims), roi(roi), stats(stats), rows(rows) {}
+
+    template <class T>
+    size_t operator()(T* begin, T* end) {
+      if(config.surrogate != surrogate_mode::none) {
+        scoped_timer timer(metrics.injection_time);
+        emulate_compression(begin, end);
+        return 0;
+      }
+
+      polymorphic_generator* gen_ptr;
+      polymorphic_distribution<T>* dist_ptr;
+      {
+        scoped_timer setup(metrics.setup_time);
+        injection_state& state = thread_injection_state(config);
+        gen_ptr = &state.generator(config);
+        dist_ptr = &state.distribution<T>(config);
+      }
+      polymorphic_generator& gen = *gen_ptr;
+      polymorphic_distribution<T>& dist = *dist_ptr;
+      dist.reset();
+
+      scoped_timer timer(metrics.injection_time);
+      const unsigned int gen_seed = stream.seed();
+      const size_t n = std::distance(begin, end);
+      T const* src_begin = (src != nullptr) ? static_cast<T const*>(src) : begin;
+      metrics.elements += n;
+      if(src_begin != begin) metrics.bytes_copied += n * sizeof(T);
+      const size_t block = (config.block_size == 0) ? std::max<size_t>(n, 1) : config.block_size;
+      noise_scale<T> scale{config.relative, 1};
+      if(config.relative == relative_mode::range) {
+        using scale_type = typename noise_scale<T>::scale_type;
+        scale.range = static_cast<scale_type>(range ? *range : range_width(find_range{block, config.nthreads}(src_begin, src_begin + n)));
+      }
+
+      if(config.correlated() && (config.count || config.probability < 1.0)) {
+        throw std::runtime_error("correlation_length requires every element to be perturbed");
+      }
+      if(roi != nullptr) {
+        if(config.correlated()) throw std::runtime_error("correlation_length is not supported with a region of interest");
+        if(src_begin != begin) std::copy(src_begin, src_begin + n, begin);
+        if(stats != nullptr) stats->add_range(src_begin, n);
+        return inject_region(begin, gen, dist, gen_seed, scale);
+      }
+      if(config.count) {
+        if(src_begin != begin) std::copy(src_begin, src_begin + n, begin);
+        if(stats != nullptr) stats->add_range(src_begin, n);
+        metrics.injections += inject_count([begin](size_t i) -> T& { return begin[i]; }, n, gen, dist, gen_seed, first_block, scale, stats);
+        return 1;
+      }
+
+      const size_t blocks = (n + block - 1) / block;
+      std::atomic<uint64_t> injections{0};
+      std::vector<error_stats> block_stats((stats != nullptr) ? blocks : 0);
+      if(config.correlated()) {
+        inject_correlated(begin, src_begin, n, block, gen, dist, gen_seed, first_block, scale, block_stats);
+        injections = n;
+      } else if(!cache_key.empty() && inject_cached(begin, src_begin, n, block, gen, dist, gen_seed, first_block, scale, block_stats)) {
+        injections = n;
+      } else {
+        for_each_block(n, block, config.nthreads, gen, dist, gen_seed, first_block,
+            [&](size_t offset, size_t block_len, polymorphic_generator& block_gen, polymorphic_distribution<T>& block_dist) {
+          T* block_begin = begin + offset;
+          T const* block_src = src_begin + offset;
+          error_stats* slot = block_stats.empty() ? nullptr : &block_stats[offset / block];
+          if(config.probability < 1.0) {
+            if(block_src != block_begin) std::copy(block_src, block_src + block_len, block_begin);
+            if(slot != nullptr) slot->add_range(block_src, block_len);
+            injections += inject_probability([block_begin](size_t i) -> T& { return block_begin[i]; }, block_len, block_gen, block_dist, scale, slot);
+          } else if(config.relative == relative_mode::absolute && slot == nullptr) {
+            block_dist.add_to(block_src, block_src + block_len, block_begin, block_gen);
+            injections += block_len;
+          } else {
+            add_scaled(block_src, block_begin, block_len, block_gen, block_dist, scale, slot);
+            injections += block_len;
+          }
+        });
+      }
+      merge_stats(block_stats);
+      metrics.injections += injections;
+      return blocks;
+    }
+    private:
+
+    /**
+     * merges the statistics of each block into stats in order, so the result does not depend on nthreads
+     */
+    void merge_stats(std::vector<error_stats> const& block_stats) {
+      for (auto const& block : block_stats) {
+        stats->merge(block);
+      }
+    }
+
+    /**
+     * adds the noise stored in the noise cache for cache_key to src, generating it on a miss directly into a new cache
+     * file a block at a time
+     *
+     * the cached noise is exactly the samples add_to would draw, so a hit gives the same result as the dense path.  The
+     * cache is only an optimization: if the file cannot be created nothing is injected and false is returned so the
+     * caller can use the dense path, and if it cannot be published the noise is still used; either counts as a cache
+     * error.
+     *
+     * \returns true if the noise was injected
+     */
+    template <class T>
+    bool inject_cached(T* begin, T const* src_begin, size_t n, size_t block, polymorphic_generator& gen,
+        polymorphic_distribution<T>& dist, unsigned int gen_seed, size_t first_block, noise_scale<T> const& scale,
+        std::vector<error_stats>& block_stats) {
+      const std::string path = noise_cache_path(config.noise_cache_dir, cache_key);
+      mapped_noise mapped = open_noise_cache(path, cache_key, n * sizeof(T));
+      if(mapped.valid()) {
+        ++metrics.cache_hits;
+        apply_noise(begin, src_begin, static_cast<T const*>(mapped.data()), n, block, scale, block_stats);
+        return true;
+      }
+
+      noise_cache_writer created = create_noise_cache(path, cache_key, n * sizeof(T));
+      if(!created.valid()) {
+        ++metrics.cache_errors;
+        return false;
+      }
+      T* noise = static_cast<T*>(created.data());
+      for_each_block(n, block, config.nthreads, gen, dist, gen_seed, first_block,
+          [&](size_t offset, size_t block_len, polymorphic_generator& block_gen, polymorphic_distribution<T>& block_dist) {
+        block_dist.fill(noise + offset, noise + offset + block_len, block_gen);
+      });
+      apply_noise(begin, src_begin, noise, n, block, scale, block_stats);
+      if(!created.commit()) ++metrics.cache_errors;
+      return true;
+    }
+
+    /**
+     * adds the scaled noise to src_begin on nthreads threads a block at a time, accumulating the error of block i into
+     * block_stats[i] if block_stats is not empty
+     */
+    template <class T, class N>
+    void apply_noise(T* begin, T const* src_begin, N const* noise, size_t n, size_t block, noise_scale<T> const& scale,
+        std::vector<error_stats>& block_stats) {
+      const size_t blocks = (n + block - 1) / block;
+      parallel_for(blocks, config.nthreads, [&](size_t i) {
+        N const* block_noise = noise + i * block;
+        transform_chunks(src_begin + i * block, begin + i * block, std::min(block, n - i * block),
+            block_stats.empty() ? nullptr : &block_stats[i], [&](T const* in, T* out, size_t offset, size_t len) {
+          scale.apply(in, block_noise + offset, out, len);
+        });
+      });
+    }
+
+    /**
+     * replaces the buffer with the reconstruction of the configured surrogate compressor, using no random numbers
+     */
+    template <class T>
+    void emulate_compression(T* begin, T* end) {
+      if(config.correlated() || roi != nullptr) {
+        throw std::runtime_error("correlation_length and regions of interest are not supported by surrogate compressors");
+      }
+      if(config.count || config.probability < 1.0) {
+        throw std::runtime_error("surrogate compressors reconstruct every element, so count and probability are not supported");
+      }
+      if(config.surrogate == surrogate_mode::truncate && config.relative != relative_mode::absolute) {
+        throw std::runtime_error("the truncate surrogate bound is pointwise relative, so relative must be absolute");
+      }
+      const size_t n = std::distance(begin, end);
+      T const* src_begin = (src != nullptr) ? static_cast<T const*>(src) : begin;
+      metrics.elements += n;
+      metrics.injections += n;
+      if(src_begin != begin) metrics.bytes_copied += n * sizeof(T);
+      const size_t block = (config.block_size == 0) ? std::max<size_t>(n, 1) : config.block_size;
+      std::vector<error_stats> task_stats;
+      std::vector<error_stats>* task_stats_ptr = (stats != nullptr) ? &task_stats : nullptr;
+      if(config.surrogate == surrogate_mode::truncate) {
+        surrogate_truncate(src_begin, begin, n, config.error_bound, block, config.nthreads, task_stats_ptr);
+        merge_stats(task_stats);
+        return;
+      }
+
+      double bound = config.error_bound;
+      if(config.relative == relative_mode::range) {
+        bound *= range ? *range : range_width(find_range{block, config.nthreads}(src_begin, src_begin + n));
+      } else if(config.relative == relative_mode::value) {
+        throw std::runtime_error("quantize and predict surrogates support absolute and range relative bounds");
+      }
+      if(!(bound > 0)) {
+        //a zero bound is lossless
+        if(src_begin != begin) std::copy(src_begin, src_begin + n, begin);
+        if(stats != nullptr) stats->add_range(src_begin, n);
+      } else if(config.surrogate == surrogate_mode::quantize) {
+        surrogate_quantize(src_begin, begin, n, bound, block, config.nthreads, task_stats_ptr);
+      } else if(rows != nullptr) {
+        surrogate_predict(src_begin, begin, n, bound, rows->length, config.nthreads, task_stats_ptr, rows->offset, &rows->carry);
+      } else {
+        surrogate_predict(src_begin, begin, n, bound, dims.empty() ? n : dims.front(), config.nthreads, task_stats_ptr);
+      }
+      merge_stats(task_stats);
+    }
+
+    /**
+     * perturbs the elements of begin selected by roi, which are numbered in memory order and use the block streams as if
+     * they were a compact array, so the cost is proportional to the size of the region
+     *
+     * \returns the number of blocks of the stream used
+     */
+    template <class T>
+    size_t inject_region(T* begin, polymorphic_generator& gen, polymorphic_distribution<T>& dist, unsigned int gen_seed,
+        noise_scale<T> const& scale) {
+      const size_t m = roi->size();
+      auto element = [begin, this](size_t i) -> T& { return begin[roi->offset(i)]; };
+      if(config.count) {
+        metrics.injections += inject_count(element, m, gen, dist, gen_seed, first_block, scale, stats);
+        return 1;
+      }
+
+      const size_t block = (config.block_size == 0) ? std::max<size_t>(m, 1) : config.block_size;
+      std::atomic<uint64_t> injections{0};
+      //elements are already counted by add_range, so each block only records the errors it makes
+      std::vector<error_stats> block_stats((stats != nullptr) ? (m + block - 1) / block : 0);
+      for_each_block(m, block, config.nthreads, gen, dist, gen_seed, first_block,
+          [&](size_t offset, size_t block_len, polymorphic_generator& block_gen, polymorphic_distribution<T>& block_dist) {
+        error_stats* slot = block_stats.empty() ? nullptr : &block_stats[offset / block];
+        if(config.probability < 1.0) {
+          auto block_element = [&element, offset](size_t i) -> T& { return element(offset + i); };
+          injections += inject_probability(block_element, block_len, block_gen, block_dist, scale, slot);
+          return;
+        }
+        std::array<T, 4096> noise;
+        for (size_t chunk = offset; chunk < offset + block_len; chunk += noise.size()) {
+          const size_t len = std::min(noise.size(), offset + block_len - chunk);
+          block_dist.fill(noise.data(), noise.data() + len, block_gen);
+          roi->for_each_run(chunk, len, [&](size_t run_offset, size_t run_len, size_t step, size_t index) {
+            T const* run_noise = noise.data() + (index - chunk);
+            T* run_begin = begin + run_offset;
+            if(step == 1 && slot == nullptr) {
+              scale.apply(run_begin, run_noise, run_begin, run_len);
+            } else {
+              for (size_t j = 0; j < run_len; ++j) {
+                const T original = run_begin[j * step];
+                run_begin[j * step] = scale.apply(original, run_noise[j]);
+                if(slot != nullptr) slot->add_error(original, run_begin[j * step]);
+              }
+            }
+          });
+        }
+        injections += block_len;
+      });
+      merge_stats(block_stats);
+      metrics.injections += injections;
+      return (m + block - 1) / block;
+    }
+
+    /**
+     * adds spatially correlated noise to src: white noise is drawn from the block streams and convolved with a Gaussian
+     * kernel along each dimension of the data
+     *
+     * noise for integer types is correlated in double precision so it is not truncated before it is scaled
+     */
+    template <class T>
+    void inject_correlated(T* begin, T const* src_begin, size_t n, size_t block, polymorphic_generator& gen,
+        polymorphic_distribution<T>& dist, unsigned int gen_seed, size_t first_block, noise_scale<T> const& scale,
+        std::vector<error_stats>& block_stats) {
+      using noise_type = typename noise_scale<T>::scale_type;
+      scratch_buffer scratch(n * sizeof(noise_type));
+      noise_type* noise = scratch.as<noise_type>();
+      for_each_block(n, block, config.nthreads, gen, dist, gen_seed, first_block,
+          [&](size_t offset, size_t block_len, polymorphic_generator& block_gen, polymorphic_distribution<T>& block_dist) {
+        fill_noise(noise + offset, block_len, block_gen, block_dist);
+      });
+
+      std::vector<size_t> grid = dims;
+      if(grid.empty()) grid.push_back(n);
+      correlate(noise, grid, config.correlation_length.to_vector<double>(), config.nthreads);
+      apply_noise(begin, src_begin, noise, n, block, scale, block_stats);
+    }
+
+    template <class T>
+    void fill_noise(T* noise, size_t n, polymorphic_generator& gen, polymorphic_distribution<T>& dist) {
+      dist.fill(noise, noise + n, gen);
+    }
+    template <class N, class T>
+    void fill_noise(N* noise, size_t n, polymorphic_generator& gen, polymorphic_distribution<T>& dist) {
+      std::array<T, 4096> samples;
+      for (size_t offset = 0; offset < n; offset += samples.size()) {
+        const size_t len = std::min(samples.size(), n - offset);
+        dist.fill(samples.data(), samples.data() + len, gen);
+        std::copy(samples.begin(), samples.begin() + len, noise + offset);
+      }
+    }
+
+    /**
+     * writes src plus scaled noise to dst, sampling the noise a cache sized chunk at a time so the data is read and
+     * written once
+     */
+    template <class T>
+    void add_scaled(T const* src, T* dst, size_t n, polymorphic_generator& gen, polymorphic_distribution<T>& dist,
+        noise_scale<T> const& scale, error_stats* block_stats) {
+      std::array<T, error_stats::chunk_size> noise;
+      transform_chunks(src, dst, n, block_stats, [&](T const* in, T* out, size_t, size_t len) {
+        dist.fill(noise.data(), noise.data() + len, gen);
+        scale.apply(in, noise.data(), out, len);
+      });
+    }
+
+    /**
+     * perturbs each element with independent probability config.probability, visiting only the perturbed elements by
+     * drawing the gaps between them from a geometric distribution
+     *
+     * \param[in] element maps an index in [0, n) to a reference to the element
+     * \returns the number of perturbed elements
+     */
+    template <class T, class Element>
+    uint64_t inject_probability(Element element, size_t n, polymorphic_generator& gen, polymorphic_distribution<T>& dist,
+        noise_scale<T> const& scale, error_stats* block_stats) {
+      std::geometric_distribution<size_t> gap(config.probability);
+      uint64_t injections = 0;
+      for (size_t i = 0; ; ++i) {
+        const size_t skip = gap(gen);
+        if(skip >= n - i) break;
+        i += skip;
+        T& value = element(i);
+        const T original = value;
+        value = scale.apply(original, dist(gen));
+        if(block_stats != nullptr) block_stats->add_error(original, value);
+        ++injections;
+      }
+      return injections;
+    }
+
+    /**
+     * perturbs exactly config.count distinct elements chosen uniformly at random from the stream of a single block
+     *
+     * \param[in] element maps an index in [0, n) to a reference to the element
+     */
+    template <class T, class Element>
+    uint64_t inject_count(Element element, size_t n, polymorphic_generator& gen, polymorphic_distribution<T>& dist, unsigned int gen_seed, size_t block,
+        noise_scale<T> const& scale, error_stats* count_stats) {
+      auto count_gen = generator_for_block(gen, gen_seed, block);
+      const std::vector<size_t> indices = sample_indices(n, *config.count, *count_gen);
+      std::unique_ptr<T[]> noise(new T[indices.size()]);
+      dist.fill(noise.get(), noise.get() + indices.size(), *count_gen);
+      for (size_t i = 0; i < indices.size(); ++i) {
+        T& value = element(indices[i]);
+        const T original = value;
+        value = scale.apply(original, noise[i]);
+        if(count_stats != nullptr) count_stats->add_error(original, value);
+      }
+      return indices.size();
+    }
+
+    injection_config const& config;
+    injection_stream const& stream;
+    injection_metrics& metrics;
+    void const* src;
+    size_t first_block;
+    std::string const& cache_key;
+    compat::optional<double> const& range;
+    std::vector<size_t> const& dims;
+    region const* roi;
+    error_stats* stats;
+    slab_rows* rows;
+  };
+
+  /**
+   * the output of every compression: a header holding the magic number, dtype, and dimensions of the input, followed by
+   * one frame per slab holding the number of elements in the slab, the size of the compressed slab, and the compressed
+   * slab.  In-memory compression writes the whole input as a single frame.
+   *
+   * Because both paths write the header, the decoder never has to guess the format from the child's output.
+   */
+  constexpr char stream_magic[8] = {'L', 'P', 'E', 'I', 'S', 'T', 'M', '1'};
+
+  /**
+   * \returns the number of elements in one plane of the slowest varying dimension of dims, the last dimension
+   */
+  size_t plane_size(std::vector<size_t> const& dims) {
+    size_t plane = 1;
+    for (size_t d = 0; d + 1 < dims.size(); ++d) {
+      plane *= dims[d];
+    }
+    return plane;
+  }
+
+  /**
+   * \returns the dimensions of a slab of len elements cut from an array of dimensions dims along its slowest varying
+   * dimension, or {len} if len is not a whole number of planes
+   */
+  std::vector<size_t> slab_dimensions(std::vector<size_t> dims, size_t len) {
+    const size_t plane = plane_size(dims);
+    if(dims.empty() || plane == 0 || len % plane != 0) return {len};
+    dims.back() = len / plane;
+    return dims;
+  }
+
+  class frame_writer {
+    public:
+    frame_writer()=default;
+    frame_writer(frame_writer const&)=delete;
+    frame_writer& operator=(frame_writer const&)=delete;
+    ~frame_writer() { std::free(buffer); }
+
+    template <class T>
+    void append(T const& value) {
+      append(&value, sizeof(T));
+    }
+    void append(void const* data, size_t bytes) {
+      if(size + bytes > capacity) {
+        const size_t new_capacity = std::max(size + bytes, capacity * 2);
+        void* grown = std::realloc(buffer, new_capacity);
+        if(!grown) throw std::bad_alloc();
+        buffer = static_cast<uint8_t*>(grown);
+        capacity = new_capacity;
+      }
+      std::memcpy(buffer + size, data, bytes);
+      size += bytes;
+    }
+
+    /**
+     * writes the stream header for an input of dtype and dims
+     */
+    void append_header(pressio_dtype dtype, std::vector<size_t> const& dims) {
+      append(stream_magic, sizeof(stream_magic));
+      append(static_cast<int32_t>(dtype));
+      append(static_cast<uint64_t>(dims.size()));
+      for (size_t dim : dims) {
+        append(static_cast<uint64_t>(dim));
+      }
+    }
+
+    /**
+     * writes a frame holding a slab of len elements compressed to compressed, which must be in host memory
+     */
+    void append_frame(size_t len, pressio_data const& compressed) {
+      append(static_cast<uint64_t>(len));
+      append(static_cast<uint64_t>(compressed.size_in_bytes()));
+      append(compressed.data(), compressed.size_in_bytes());
+    }
+
+    /**
+     * transfers the written bytes to a pressio_data without copying
+     */
+    pressio_data release() {
+      pressio_data data = pressio_data::move(pressio_byte_dtype, buffer, {size}, pressio_data_libc_free_fn, nullptr);
+      buffer = nullptr;
+      size = capacity = 0;
+      return data;
+    }
+
+    private:
+    uint8_t* buffer = nullptr;
+    size_t size = 0, capacity = 0;
+  };
+
+  class frame_reader {
+    public:
+    frame_reader(uint8_t const* begin, size_t size): pos(begin), end(begin + size) {}
+
+    template <class T>
+    T read() {
+      T value;
+      std::memcpy(&value, read(sizeof(T)), sizeof(T));
+      return value;
+    }
+    uint8_t const* read(size_t bytes) {
+      if(static_cast<size_t>(end - pos) < bytes) throw std::runtime_error("truncated stream");
+      uint8_t const* begin = pos;
+      pos += bytes;
+      return begin;
+    }
+    bool done() const { return pos == end; }
+    size_t remaining() const { return static_cast<size_t>(end - pos); }
+
+    private:
+    uint8_t const* pos;
+    uint8_t const* end;
+  };
+
+  /**
+   * true if data is host memory owned by the pressio_data which may be modified in place
+   */
+  bool is_owned_host_data(pressio_data const& data) {
+    return data.has_data() && data.domain() && std::string(data.domain()->prefix()) == "malloc";
+  }
 }
 
 class random_error_injector_plugin: public libpressio_compressor_plugin {
@@ -75,10 +930,30 @@ class random_error_injector_plugin: public libpressio_compressor_plugin {
   struct pressio_options 	get_options_impl () const override {
     struct pressio_options options = pressio_options();
     set_meta(options, "random_error_injector:compressor", compressor_name, compressor);
-    set(options, "random_error_injector:seed", seed);
-    set(options, "random_error_injector:dist_name", dist_name);
-    set(options, "random_error_injector:gen_name", gen_name);
-    set(options, "random_error_injector:dist_args", dist_args);
+    set(options, "random_error_injector:seed", config->seed);
+    set(options, "random_error_injector:dist_name", config->dist_name);
+    set(options, "random_error_injector:gen_name", config->gen_name);
+    set(options, "random_error_injector:dist_args", config->dist_args);
+    set(options, "random_error_injector:block_size", config->block_size);
+    set(options, "random_error_injector:nthreads", config->nthreads);
+    set(options, "random_error_injector:probability", config->probability);
+    set(options, "random_error_injector:count", config->count);
+    set(options, "random_error_injector:in_place", config->in_place);
+    set(options, "random_error_injector:continue_stream", config->continue_stream);
+    set(options, "random_error_injector:noise_cache_dir", config->noise_cache_dir);
+    set(options, "random_error_injector:stream_chunk_size", config->stream_chunk_size);
+    set(options, "random_error_injector:pipeline_depth", config->pipeline_depth);
+    set(options, "random_error_injector:stream_input_file", config->stream_input_file);
+    set(options, "random_error_injector:stream_output_file", config->stream_output_file);
+    set(options, "random_error_injector:relative", to_string(config->relative));
+    set(options, "random_error_injector:correlation_length", config->correlation_length);
+    set(options, "random_error_injector:roi_start", config->roi_start);
+    set(options, "random_error_injector:roi_count", config->roi_count);
+    set(options, "random_error_injector:roi_stride", config->roi_stride);
+    set(options, "random_error_injector:roi_mask", config->roi_mask);
+    set(options, "random_error_injector:surrogate", to_string(config->surrogate));
+    set(options, "random_error_injector:error_bound", config->error_bound);
+    set(options, "random_error_injector:compute_error_stats", config->compute_error_stats);
     return options;
   };
 
@@ -90,6 +965,40 @@ class random_error_injector_plugin: public libpressio_compressor_plugin {
     set(options, "random_error_injector:dist_name", "name of the error distribution to use");
     set(options, "random_error_injector:gen_name", "name of the random number generator to use");
     set(options, "random_error_injector:dist_args", "the distribution arguments");
+    set(options, "random_error_injector:block_size", "number of elements in each independently seeded block of the input, 0 uses a single stream for the entire input; results depend on block_size but not nthreads");
+    set(options, "random_error_injector:nthreads", "number of threads used to inject errors");
+    set(options, "random_error_injector:probability", "probability in (0, 1] that each element is perturbed, runtime scales with the number of perturbed elements");
+    set(options, "random_error_injector:count", "if set, perturb exactly this many distinct elements chosen uniformly at random instead of using probability");
+    set(options, "random_error_injector:in_place", "if non-zero and the input is owned host memory, inject errors directly into the caller's input rather than a copy; the input is modified");
+    set(options, "random_error_injector:continue_stream", "if non-zero, each compress call continues the random stream where the previous call stopped instead of restarting it from the seed; without a seed the time of the first call is used");
+    set(options, "random_error_injector:noise_cache_dir", "if set, directory of memory mapped noise buffers; when every element is perturbed with a fixed seed, noise is generated once per seed, generator, distribution, arguments, dtype, and dimensions and later calls add the stored noise instead of sampling");
+    set(options, "random_error_injector:stream_chunk_size", "if non-zero, inject and compress the input in slabs of about this many elements, rounded up to whole planes of the slowest varying (last) dimension and to whole blocks when block_size is a multiple of the plane size; each slab keeps the inner dimensions of the input, the errors are identical to the in-memory path, each slab is compressed separately by the child compressor and count is not supported.  The compressed slabs are collected in the output, so peak memory is the resident slabs plus the compressed size of the whole input, about the size of the input for noop or other low ratio children; set stream_output_file to bound memory by the slab size");
+    set(options, "random_error_injector:pipeline_depth", "if non-zero while streaming, compress or write each slab on a second thread while errors are injected into up to this many following slabs, hiding injection time behind compression; pipeline_depth + 2 slabs are resident and the output is identical");
+    set(options, "random_error_injector:stream_input_file", "if set while streaming, read the input incrementally from this raw file in the dtype and dimensions of the input passed to compress, whose data is not used");
+    set(options, "random_error_injector:stream_output_file", "if set while streaming, write the input with errors to this raw file instead of compressing it; the compressed output is empty");
+    set(options, "random_error_injector:relative", "how noise is scaled: absolute adds it unchanged, range multiplies it by max - min of the input, value multiplies it by the magnitude of each element; surrogate compressors support absolute and range except truncate, which requires absolute");
+    set(options, "random_error_injector:correlation_length", "correlation length in elements along each dimension of the input, dimension 0 first; if any is positive, every element is perturbed by white noise convolved with a Gaussian kernel of that standard deviation (periodic at the boundaries and truncated to one period, mean and variance preserving) and count and probability are not supported");
+    set(options, "random_error_injector:roi_start", "first index of the region of interest along each dimension, dimension 0 first; defaults to 0");
+    set(options, "random_error_injector:roi_count", "number of elements of the region of interest along each dimension; defaults to the rest of the dimension");
+    set(options, "random_error_injector:roi_stride", "spacing of the region of interest along each dimension, for example to select one variable of interleaved data; defaults to 1");
+    set(options, "random_error_injector:roi_mask", "if set, perturb only the elements of the input where this buffer, which has one element per element of the input, is non-zero; exclusive with roi_start, roi_count, and roi_stride");
+    set(options, "random_error_injector:surrogate", "instead of adding noise, reconstruct the input like an error bounded lossy compressor: quantize to bins of width 2*error_bound, predict each element from the previous reconstructed element along dimension 0 and quantize the residual, or truncate mantissa bits of float or double data to a pointwise relative error_bound; none adds noise.  Surrogates reconstruct every element, so count and probability are not supported");
+    set(options, "random_error_injector:error_bound", "error bound of the surrogate compressor; absolute for quantize and predict unless relative is range, in which case it is multiplied by the range of the input, and pointwise relative for truncate");
+    set(options, "random_error_injector:compute_error_stats", "if non-zero, compute the error statistics max_abs_error, mse, rmse, and psnr of the last compress call while errors are injected, without another pass over the data");
+    set(options, "random_error_injector:max_abs_error", "maximum absolute difference between the input and the input with errors in the last compress call");
+    set(options, "random_error_injector:mse", "mean squared difference between the input and the input with errors in the last compress call");
+    set(options, "random_error_injector:rmse", "root mean squared difference between the input and the input with errors in the last compress call");
+    set(options, "random_error_injector:psnr", "peak signal to noise ratio in dB of the input with errors in the last compress call, using the value range of the input");
+    set(options, "random_error_injector:noise_cache_hits", "number of injections in the last compress call served from the noise cache");
+    set(options, "random_error_injector:noise_cache_errors", "number of noise cache files in the last compress call that could not be created or published; the injection proceeds without the cache");
+    set(options, "random_error_injector:setup_time", "time in milliseconds spent building or looking up the generator and distribution in the last compress call");
+    set(options, "random_error_injector:injection_time", "time in milliseconds spent generating and applying noise in the last compress call");
+    set(options, "random_error_injector:compress_time", "time in milliseconds spent in the child compressor in the last compress call");
+    set(options, "random_error_injector:decompress_time", "time in milliseconds spent in the child compressor in the last decompress call");
+    set(options, "random_error_injector:elements", "number of elements processed in the last compress call");
+    set(options, "random_error_injector:elements_perturbed", "number of elements perturbed in the last compress call");
+    set(options, "random_error_injector:bytes_copied", "number of bytes copied to make the input readable and to preserve it in the last compress call");
+    set(options, "random_error_injector:throughput", "elements per second injected in the last compress call");
     set(options, "random_error_injector:real_distributions", "available distributions for real numbers");
     set(options, "random_error_injector:int_distributions", "available distributions for integer numbers");
     set(options, "random_error_injector:generators", "available distribution generators");
@@ -103,55 +1012,472 @@ class random_error_injector_plugin: public libpressio_compressor_plugin {
     set(options, "random_error_injector:real_distributions", plugin_names(get_distribution_registry<float>()));
     set(options, "random_error_injector:int_distributions", plugin_names(get_distribution_registry<int32_t>()));
     set(options, "random_error_injector:generators", plugin_names(generator_registry()));
+    set(options, "random_error_injector:relative_modes", relative_mode_names());
+    set(options, "random_error_injector:surrogate_modes", surrogate_mode_names());
     
-        std::vector<std::string> invalidations {"random_error_injector:seed", "random_error_injector:dist_args", "random_error_injector:dist_name", "random_error_injector:gen_name"}; 
+        std::vector<std::string> invalidations {"random_error_injector:seed", "random_error_injector:dist_args", "random_error_injector:dist_name", "random_error_injector:gen_name", "random_error_injector:block_size", "random_error_injector:probability", "random_error_injector:count", "random_error_injector:continue_stream", "random_error_injector:stream_input_file", "random_error_injector:relative", "random_error_injector:correlation_length", "random_error_injector:roi_start", "random_error_injector:roi_count", "random_error_injector:roi_stride", "random_error_injector:roi_mask", "random_error_injector:surrogate", "random_error_injector:error_bound"}; 
+        std::vector<std::string> runtime_invalidations = invalidations;
+        runtime_invalidations.emplace_back("random_error_injector:nthreads");
+        runtime_invalidations.emplace_back("random_error_injector:stream_chunk_size");
+        runtime_invalidations.emplace_back("random_error_injector:pipeline_depth");
+        runtime_invalidations.emplace_back("random_error_injector:stream_output_file");
         std::vector<pressio_configurable const*> invalidation_children {&*compressor}; 
         
         set(options, "predictors:error_dependent", get_accumulate_configuration("predictors:error_dependent", invalidation_children, invalidations));
         set(options, "predictors:error_agnostic", get_accumulate_configuration("predictors:error_agnostic", invalidation_children, invalidations));
-        set(options, "predictors:runtime", get_accumulate_configuration("predictors:runtime", invalidation_children, invalidations));
+        set(options, "predictors:runtime", get_accumulate_configuration("predictors:runtime", invalidation_children, runtime_invalidations));
 
     return options;
   };
 
   int 	set_options_impl (struct pressio_options const& options) override {
-    get(options, "random_error_injector:seed", &seed);
+    //options are applied to a copy that replaces the shared snapshot, so clones sharing the old snapshot are unaffected
+    injection_config next = *config;
+    get(options, "random_error_injector:seed", &next.seed);
     std::string tmp_name;
     if(get(options, "random_error_injector:dist_name", &tmp_name) == pressio_options_key_set) {
       if(get_distribution_registry<float>().contains(tmp_name) || get_distribution_registry<uint64_t>().contains(tmp_name)) {
-        dist_name = std::move(tmp_name);
+        next.dist_name = std::move(tmp_name);
       }
     }
 
     if(get(options, "random_error_injector:gen_name", &tmp_name) == pressio_options_key_set) {
       if(generator_registry().contains(tmp_name)) {
-        gen_name = std::move(tmp_name);
+        next.gen_name = std::move(tmp_name);
       }
 
     }
 
-    get(options, "random_error_injector:dist_args", &dist_args);
+    get(options, "random_error_injector:dist_args", &next.dist_args);
+    get(options, "random_error_injector:block_size", &next.block_size);
+    get(options, "random_error_injector:nthreads", &next.nthreads);
+    double probability;
+    if(get(options, "random_error_injector:probability", &probability) == pressio_options_key_set) {
+      if(!(probability > 0.0 && probability <= 1.0)) {
+        return set_error(3, "probability must be in (0, 1]");
+      }
+      next.probability = probability;
+    }
+    get(options, "random_error_injector:count", &next.count);
+    get(options, "random_error_injector:in_place", &next.in_place);
+    get(options, "random_error_injector:continue_stream", &next.continue_stream);
+    get(options, "random_error_injector:noise_cache_dir", &next.noise_cache_dir);
+    get(options, "random_error_injector:stream_chunk_size", &next.stream_chunk_size);
+    get(options, "random_error_injector:pipeline_depth", &next.pipeline_depth);
+    get(options, "random_error_injector:stream_input_file", &next.stream_input_file);
+    get(options, "random_error_injector:stream_output_file", &next.stream_output_file);
+    get(options, "random_error_injector:correlation_length", &next.correlation_length);
+    get(options, "random_error_injector:compute_error_stats", &next.compute_error_stats);
+    get(options, "random_error_injector:roi_start", &next.roi_start);
+    get(options, "random_error_injector:roi_count", &next.roi_count);
+    get(options, "random_error_injector:roi_stride", &next.roi_stride);
+    get(options, "random_error_injector:roi_mask", &next.roi_mask);
+    if(get(options, "random_error_injector:surrogate", &tmp_name) == pressio_options_key_set) {
+      try {
+        next.surrogate = surrogate_mode_from_string(tmp_name);
+      } catch (std::invalid_argument const&) {
+        return set_error(3, "invalid surrogate " + tmp_name);
+      }
+    }
+    double error_bound;
+    if(get(options, "random_error_injector:error_bound", &error_bound) == pressio_options_key_set) {
+      if(!(error_bound >= 0)) {
+        return set_error(3, "error_bound must be non-negative");
+      }
+      next.error_bound = error_bound;
+    }
+    if(get(options, "random_error_injector:relative", &tmp_name) == pressio_options_key_set) {
+      try {
+        next.relative = relative_mode_from_string(tmp_name);
+      } catch (std::invalid_argument const&) {
+        return set_error(3, "invalid relative mode " + tmp_name);
+      }
+    }
     get_meta(options, "random_error_injector:compressor", compressor_plugins(), compressor_name, compressor);
 
+    auto snapshot = make_snapshot(std::move(next));
+    if(snapshot->state_key != config->state_key || snapshot->seed != config->seed ||
+       snapshot->continue_stream != config->continue_stream) {
+      stream.restart();
+    }
+    config = std::move(snapshot);
     return 0;
   }
 
   int 	compress_impl (const pressio_data *input, struct pressio_data *output) override {
-    pressio_data tmp = pressio_data::clone(domain_manager().make_readable(domain_plugins().build("malloc"),*input));
+    metrics.reset_compress();
+    errors = error_stats{};
+    stream.begin_call(*config);
+    if(config->stream_chunk_size > 0) {
+      return compress_streaming(input, output);
+    }
+
+    size_t blocks;
+    if(config->in_place && is_owned_host_data(*input)) {
+      //the caller opted in to having their input modified, so skip the copy entirely
+      pressio_data& data = const_cast<pressio_data&>(*input);
+      if(int ret = inject(data, nullptr, 0, blocks)) return ret;
+      stream.advance(*config, blocks);
+      return compress_frame(*input, output);
+    }
+
+    pressio_data readable = domain_manager().make_readable(domain_plugins().build("malloc"), *input);
+    if(readable.data() != input->data()) metrics.bytes_copied += readable.size_in_bytes();
+    //the perturbed copy is as large as the input, so it is freed when this returns rather than kept in the scratch pool
+    pressio_data tmp = pressio_data::owning(readable.dtype(), readable.dimensions());
+    if(int ret = inject(tmp, readable.data(), 0, blocks)) return ret;
+    stream.advance(*config, blocks);
+    return compress_frame(tmp, output);
+  };
+
+  /**
+   * compresses data with the child compressor and writes it to output as a stream holding a single frame
+   */
+  int compress_frame(pressio_data const& data, struct pressio_data* output) {
+    pressio_data compressed = pressio_data::empty(pressio_byte_dtype, {});
+    if(int ret = compress_child(&data, &compressed)) return set_error(ret, compressor->error_msg());
+    compressed = domain_manager().make_readable(domain_plugins().build("malloc"), std::move(compressed));
+    frame_writer frames;
+    frames.append_header(data.dtype(), data.dimensions());
+    frames.append_frame(data.num_elements(), compressed);
+    *output = frames.release();
+    return 0;
+  }
+
+  /**
+   * injects errors one slab at a time so only one slab of the input needs to be resident
+   *
+   * slabs use the block streams at their position in the input, so the errors are identical to injecting into the
+   * whole input.  The input is read from stream_input_file if set, otherwise from input which may be memory mapped.
+   * Each slab is appended to stream_output_file if set, otherwise it is compressed by the child compressor into a frame
+   * of output.  If pipeline_depth is set, slabs are emitted on a second thread while errors are injected into up to
+   * pipeline_depth following slabs, so pipeline_depth + 2 slabs are resident.
+   *
+   * Frames are collected in memory until this returns, so peak memory is bounded by the slab size only when writing to
+   * stream_output_file; with a child compressor it also includes the compressed size of the whole input.
+   *
+   * Slabs are whole planes of the slowest varying dimension, so the child sees arrays with the inner dimensions of the
+   * input.  When a slab is not a whole number of blocks, errors are injected a whole number of blocks at a time into a
+   * staging buffer that carries the part of the last block past the end of one slab into the next.
+   */
+  int compress_streaming(const pressio_data *input, struct pressio_data *output) {
+    if(config->count) return set_error(4, "count is not supported when streaming");
+    if(config->correlated()) return set_error(4, "correlation_length is not supported when streaming");
+    if(config->has_region()) return set_error(4, "a region of interest is not supported when streaming");
+    if(config->block_size == 0) return set_error(4, "block_size must be non-zero when streaming");
+    const pressio_dtype dtype = input->dtype();
+    const size_t element_size = pressio_dtype_size(dtype);
+    const size_t n = input->num_elements();
+    const std::vector<size_t> dims = input->dimensions().empty() ? std::vector<size_t>{n} : input->dimensions();
+    const size_t block = config->block_size;
+    //slabs are rounded to whole blocks when blocks are whole planes so no staging is needed
+    const size_t plane = std::max<size_t>(plane_size(dims), 1);
+    const size_t unit = (block % plane == 0) ? block : plane;
+    const size_t slab = std::max<size_t>((config->stream_chunk_size + unit - 1) / unit, 1) * unit;
+    //surrogate compressors draw no random numbers, so their slabs need not start on a block
+    const bool aligned = config->surrogate != surrogate_mode::none || slab % block == 0;
+
+    pressio_data readable;
+    std::ifstream source;
+    if(config->stream_input_file.empty()) {
+      readable = domain_manager().make_readable(domain_plugins().build("malloc"), *input);
+      if(readable.data() != input->data()) metrics.bytes_copied += readable.size_in_bytes();
+    } else {
+      source.open(config->stream_input_file, std::ios::binary);
+      if(!source) return set_error(4, "failed to open " + config->stream_input_file);
+    }
+    std::ofstream sink;
+    if(!config->stream_output_file.empty()) {
+      sink.open(config->stream_output_file, std::ios::binary | std::ios::trunc);
+      if(!sink) return set_error(4, "failed to open " + config->stream_output_file);
+    }
+
+    frame_writer frames;
+    frames.append_header(dtype, input->dimensions());
+
+    scratch_buffer chunk_buffer(std::min(slab, n) * element_size);
+    compat::optional<double> range;
+    if(config->relative == relative_mode::range) {
+      //noise is scaled by the range of the whole input, not of each slab, so find it before injecting
+      std::pair<double, double> extent{std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+      const find_range slab_range{config->block_size, config->nthreads};
+      for (size_t offset = 0; offset < n; offset += slab) {
+        const size_t len = std::min(slab, n - offset);
+        pressio_data window;
+        if(source.is_open()) {
+          if(!source.read(static_cast<char*>(chunk_buffer.data()), len * element_size)) {
+            return set_error(4, "failed to read " + config->stream_input_file);
+          }
+          window = pressio_data::nonowning(dtype, chunk_buffer.data(), {len});
+        } else {
+          window = pressio_data::nonowning(dtype, static_cast<uint8_t*>(readable.data()) + offset * element_size, {len});
+        }
+        auto slab_extent = pressio_data_for_each<std::pair<double, double>>(window, slab_range);
+        extent.first = std::min(extent.first, slab_extent.first);
+        extent.second = std::max(extent.second, slab_extent.second);
+      }
+      if(source.is_open()) {
+        source.clear();
+        source.seekg(0);
+      }
+      range = range_width(extent);
+    }
+
+    size_t blocks = 0;
+    slab_rows rows{dims.front(), 0, predict_carry{}};
+    //fills buffer with the len elements at offset plus errors, offset is the start of a block
+    auto inject_range = [&](size_t offset, size_t len, void* buffer) -> int {
+      pressio_data chunk = pressio_data::nonowning(dtype, buffer, slab_dimensions(dims, len));
+      void const* src = nullptr;
+      if(source.is_open()) {
+        if(!source.read(static_cast<char*>(buffer), len * element_size)) {
+          return set_error(4, "failed to read " + config->stream_input_file);
+        }
+      } else {
+        src = static_cast<uint8_t const*>(readable.data()) + offset * element_size;
+      }
+
+      size_t range_blocks;
+      rows.offset = offset % rows.length;
+      if(int ret = inject(chunk, src, offset / block, range_blocks, range, &rows)) return ret;
+      blocks += range_blocks;
+      return 0;
+    };
+    std::unique_ptr<scratch_buffer> staging;
+    size_t carried = 0;
+    //fills buffer with the slab at offset plus errors; slabs must be produced in order
+    auto inject_slab = [&](size_t offset, void* buffer) -> int {
+      const size_t len = std::min(slab, n - offset);
+      if(aligned) return inject_range(offset, len, buffer);
+
+      if(!staging) staging = compat::make_unique<scratch_buffer>((slab + block) * element_size);
+      uint8_t* staged = staging->as<uint8_t>();
+      size_t ready = carried;
+      if(ready < len) {
+        //the carried elements end on a block, so inject through the end of the block holding the end of the slab
+        const size_t end = std::min(n, (offset + len + block - 1) / block * block);
+        if(int ret = inject_range(offset + ready, end - offset - ready, staged + ready * element_size)) return ret;
+        ready = end - offset;
+      }
+      std::memcpy(buffer, staged, len * element_size);
+      std::memmove(staged, staged + len * element_size, (ready - len) * element_size);
+      carried = ready - len;
+      return 0;
+    };
+    //writes or compresses a slab of len elements; failures are returned with their message in emit_msg rather than set
+    //on the plugin because this may run on another thread while errors are injected
+    std::string emit_msg;
+    auto emit_slab = [&](void* buffer, size_t len) -> int {
+      if(sink.is_open()) {
+        if(!sink.write(static_cast<char const*>(buffer), len * element_size)) {
+          emit_msg = "failed to write " + config->stream_output_file;
+          return 4;
+        }
+        return 0;
+      }
+      pressio_data chunk = pressio_data::nonowning(dtype, buffer, slab_dimensions(dims, len));
+      pressio_data compressed = pressio_data::empty(pressio_byte_dtype, {});
+      if(int ret = compress_child(&chunk, &compressed)) {
+        emit_msg = compressor->error_msg();
+        return ret;
+      }
+      compressed = domain_manager().make_readable(domain_plugins().build("malloc"), std::move(compressed));
+      frames.append_frame(len, compressed);
+      return 0;
+    };
+
+    if(config->pipeline_depth == 0) {
+      for (size_t offset = 0; offset < n; offset += slab) {
+        if(int ret = inject_slab(offset, chunk_buffer.data())) return ret;
+        if(int ret = emit_slab(chunk_buffer.data(), std::min(slab, n - offset))) return set_error(ret, emit_msg);
+      }
+    } else {
+      //errors are injected into later slabs on this thread while the child compresses earlier slabs on another; the
+      //buffers are borrowed here so they return to this thread's pool
+      std::vector<std::unique_ptr<scratch_buffer>> buffers;
+      for (size_t slot = 0; slot < config->pipeline_depth + 2; ++slot) {
+        buffers.push_back(compat::make_unique<scratch_buffer>(std::min(slab, n) * element_size));
+      }
+      int inject_ret = 0, emit_ret = 0;
+      pipeline((n + slab - 1) / slab, config->pipeline_depth,
+          [&](size_t i, size_t slot) {
+            inject_ret = inject_slab(i * slab, buffers[slot]->data());
+            return inject_ret == 0;
+          },
+          [&](size_t i, size_t slot) {
+            emit_ret = emit_slab(buffers[slot]->data(), std::min(slab, n - i * slab));
+            return emit_ret == 0;
+          });
+      if(inject_ret) return inject_ret;
+      if(emit_ret) return set_error(emit_ret, emit_msg);
+    }
+    stream.advance(*config, blocks);
+
+    if(sink.is_open()) {
+      *output = pressio_data::empty(pressio_byte_dtype, {0});
+    } else {
+      *output = frames.release();
+    }
+    return 0;
+  }
+
+  int compress_child(const pressio_data *input, struct pressio_data *output) {
+    scoped_timer timer(metrics.compress_time);
+    return compressor->compress(input, output);
+  }
+
+  /**
+   * injects errors into data, first copying the contents of src if it is not null
+   *
+   * \param[in] block_offset the position of data in the stream in blocks relative to the start of this call
+   * \param[out] blocks the number of blocks of the stream used
+   * \param[in] range the range of the whole input for range relative noise, computed from data if not set
+   * \param[in,out] rows where data lies within the rows of the whole input when streaming, otherwise rows are dimension 0
+   * of data
+   */
+  int inject(pressio_data& data, void const* src, size_t block_offset, size_t& blocks,
+      compat::optional<double> const& range = compat::optional<double>{}, slab_rows* rows = nullptr) {
     try {
-    pressio_data_for_each<int>(tmp, inject_error(dist_args, seed, gen_name, dist_name));
+    const size_t first_block = stream.first_block(*config) + block_offset;
+    const std::string cache_key = noise_cache_key(data, first_block);
+    const compat::optional<region> roi = region_of_interest(data);
+    blocks = pressio_data_for_each<size_t>(data, inject_error(*config, stream, metrics, src, first_block, cache_key, range, data.dimensions(),
+          roi ? &*roi : nullptr, config->compute_error_stats ? &errors : nullptr, rows));
     } catch (std::invalid_argument const&) {
-      return set_error(1, "invalid number of arguments passed " + std::to_string(dist_args.num_elements()));
+      return set_error(1, "invalid number of arguments passed " + std::to_string(config->dist_args.num_elements()));
     } catch (std::runtime_error const& e) {
       return set_error(2, e.what());
     }
-    return compressor->compress(&tmp, output);
-  };
+    return 0;
+  }
+
+  /**
+   * \returns the region of data to perturb, or an empty optional if every element is perturbed
+   */
+  compat::optional<region> region_of_interest(pressio_data const& data) const {
+    if(config->roi_mask.num_elements() > 0) {
+      if(config->roi_start.num_elements() > 0 || config->roi_count.num_elements() > 0 || config->roi_stride.num_elements() > 0) {
+        throw std::runtime_error("set either roi_mask or roi_start, roi_count, and roi_stride");
+      }
+      if(config->roi_mask.num_elements() != data.num_elements()) {
+        throw std::runtime_error("roi_mask must have the same number of elements as the input");
+      }
+      return pressio_data_for_each<region>(config->roi_mask, make_mask_region{});
+    }
+    if(!config->has_region()) return compat::optional<region>{};
+    return region::hyperslab(data.dimensions(), config->roi_start.to_vector<size_t>(), config->roi_count.to_vector<size_t>(),
+        config->roi_stride.to_vector<size_t>());
+  }
+
+  /**
+   * \returns the noise cache key for injecting into data, or an empty string if the noise cache does not apply
+   *
+   * the noise cache only applies when every element is perturbed with a fixed seed
+   */
+  std::string noise_cache_key(pressio_data const& data, size_t first_block) {
+    if(config->noise_cache_dir.empty() || !config->seed || config->count || config->probability < 1.0 || config->correlated() ||
+       config->has_region()) return "";
+    std::ostringstream key;
+    key << std::hexfloat
+      << "seed=" << *config->seed
+      << ";gen=" << config->gen_name
+      << ";dist=" << config->dist_name
+      << ";args=";
+    for (double arg : config->dist_args.to_vector<double>()) {
+      key << arg << ',';
+    }
+    key << ";dtype=" << static_cast<int>(data.dtype()) << ";dims=";
+    for (size_t dim : data.dimensions()) {
+      key << dim << ',';
+    }
+    key << ";block_size=" << config->block_size
+      << ";first_block=" << first_block;
+    return key.str();
+  }
 
    int 	decompress_impl (const pressio_data *input, struct pressio_data *output) override {
-     return compressor->decompress(input, output);
+     metrics.decompress_time = 0;
+     scoped_timer timer(metrics.decompress_time);
+     pressio_data readable = domain_manager().make_readable(domain_plugins().build("malloc"), *input);
+     if(readable.size_in_bytes() < sizeof(stream_magic) ||
+        std::memcmp(readable.data(), stream_magic, sizeof(stream_magic)) != 0) {
+       return set_error(5, "input was not compressed by random_error_injector");
+     }
+     try {
+       return decompress_frames(readable, output);
+     } catch (std::runtime_error const& e) {
+       return set_error(5, e.what());
+     } catch (std::bad_alloc const&) {
+       return set_error(5, "the stream is too large to decompress");
+     }
    }
 
+  /**
+   * decompresses each frame written by compress into its slab of output
+   *
+   * the header and frame sizes come from the input, so each is checked against the bytes that remain before it is used
+   *
+   * \param[in] readable the compressed input in host memory, starting with stream_magic
+   */
+  int decompress_frames(pressio_data const& readable, struct pressio_data *output) {
+    frame_reader frames(static_cast<uint8_t const*>(readable.data()), readable.size_in_bytes());
+    frames.read(sizeof(stream_magic));
+    const pressio_dtype dtype = static_cast<pressio_dtype>(frames.read<int32_t>());
+    const size_t element_size = pressio_dtype_size(dtype);
+    if(element_size == 0) throw std::runtime_error("invalid dtype in the stream header");
+    const uint64_t ndims = frames.read<uint64_t>();
+    if(ndims > frames.remaining() / sizeof(uint64_t)) throw std::runtime_error("truncated stream");
+    std::vector<size_t> dims(ndims);
+    size_t n = ndims > 0 ? 1 : 0;
+    for (auto& dim : dims) {
+      dim = frames.read<uint64_t>();
+      if(dim != 0 && n > std::numeric_limits<size_t>::max() / element_size / dim) {
+        throw std::runtime_error("invalid dimensions in the stream header");
+      }
+      n *= dim;
+    }
+    *output = pressio_data::owning(dtype, dims);
+
+    size_t offset = 0;
+    while(!frames.done()) {
+      const size_t len = frames.read<uint64_t>();
+      if(len > n - offset) return set_error(5, "slab size does not match the stream");
+      const size_t bytes = frames.read<uint64_t>();
+      pressio_data frame = pressio_data::nonowning(pressio_byte_dtype, const_cast<uint8_t*>(frames.read(bytes)), {bytes});
+      pressio_data slab = pressio_data::owning(dtype, slab_dimensions(dims, len));
+      if(int ret = compressor->decompress(&frame, &slab)) return set_error(ret, compressor->error_msg());
+      slab = domain_manager().make_readable(domain_plugins().build("malloc"), std::move(slab));
+      if(slab.size_in_bytes() != len * element_size) {
+        return set_error(5, "slab size does not match the stream");
+      }
+      std::memcpy(static_cast<uint8_t*>(output->data()) + offset * element_size, slab.data(), slab.size_in_bytes());
+      offset += len;
+    }
+    if(offset != n) return set_error(5, "truncated stream");
+    return 0;
+  }
+
+  struct pressio_options get_metrics_results_impl() const override {
+    pressio_options options = compressor->get_metrics_results();
+    set(options, "random_error_injector:setup_time", metrics.setup_time);
+    set(options, "random_error_injector:injection_time", metrics.injection_time);
+    set(options, "random_error_injector:throughput", (metrics.injection_time > 0) ? metrics.elements / (metrics.injection_time / 1000.0) : 0.0);
+    set(options, "random_error_injector:compress_time", metrics.compress_time);
+    set(options, "random_error_injector:decompress_time", metrics.decompress_time);
+    set(options, "random_error_injector:elements", metrics.elements);
+    set(options, "random_error_injector:elements_perturbed", metrics.injections);
+    set(options, "random_error_injector:bytes_copied", metrics.bytes_copied);
+    set(options, "random_error_injector:noise_cache_hits", metrics.cache_hits);
+    set(options, "random_error_injector:noise_cache_errors", metrics.cache_errors);
+    if(config->compute_error_stats) {
+      set(options, "random_error_injector:max_abs_error", errors.max_abs);
+      set(options, "random_error_injector:mse", errors.mse());
+      set(options, "random_error_injector:rmse", errors.rmse());
+      set(options, "random_error_injector:psnr", errors.psnr());
+    }
+    return options;
+  }
+
   public:
 
   int	major_version () const override {
@@ -177,9 +1503,11 @@ class random_error_injector_plugin: public libpressio_compressor_plugin {
   }
 
   private:
-  std::string dist_name="uniform_real_distribution", gen_name="mt19937_64", compressor_name = "noop";
-  pressio_data dist_args;
-  compat::optional<unsigned int> seed;
+  std::string compressor_name = "noop";
+  std::shared_ptr<const injection_config> config = make_snapshot(injection_config{});
+  injection_stream stream;
+  injection_metrics metrics;
+  error_stats errors;
   pressio_compressor compressor = compressor_plugins().build("noop");
 };
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <stdexcept>
 #include <memory>
@@ -6,20 +7,47 @@
 #include <stdexcept>
 #include <std_compat/std_compat.h>
 #include "random_distributions.h"
+#include "counter_based_engines.h"
+#include "simd_distributions.h"
+
+/**
+ * engines that already produce the full 32 bit range are used directly, all others are adapted to it
+ */
+template <class Engine>
+using narrowed_engine = typename std::conditional<
+  Engine::min() == polymorphic_generator::min() && Engine::max() == polymorphic_generator::max(),
+  Engine,
+  std::independent_bits_engine<Engine, 32, polymorphic_generator::result_type>
+  >::type;
 
 template <class Impl>
 class polymorphic_generator_impl : public polymorphic_generator {
   public: template <class... T>
   polymorphic_generator_impl(T&&... args): impl(std::forward<T>(args)...) {}
 
-  typename polymorphic_generator::result_type operator()() final { return impl(); }
-  void seed(std::seed_seq& seed) final { impl.seed(seed); } 
+  typename polymorphic_generator::result_type operator()() final {
+    result_type value;
+    if(take_read_ahead(&value, &value + 1)) return value;
+    return impl();
+  }
+  void generate(result_type* begin, result_type* end) final {
+    begin += take_read_ahead(begin, end);
+    std::generate(begin, end, [this]{ return impl(); });
+  }
+  void seed(std::seed_seq& seed) final {
+    clear_read_ahead();
+    impl.seed(seed);
+  }
+  void discard(unsigned long long n) final { impl.discard(n - skip_read_ahead(n)); }
+  bool constant_time_discard() const final { return has_constant_time_discard<narrowed_engine<Impl>>::value; }
   std::unique_ptr<polymorphic_generator> clone() final {
-    return compat::make_unique<polymorphic_generator_impl>(this->impl);
+    auto copy = compat::make_unique<polymorphic_generator_impl>(this->impl);
+    copy->copy_read_ahead(*this);
+    return copy;
   }
 
   private:
-  Impl impl;
+  narrowed_engine<Impl> impl;
 };
 
 template <typename T, typename ArgType, typename = void>
@@ -77,6 +105,29 @@ make_param(std::vector<double> const& params)
 
 
 
+/**
+ * true if Distribution provides its own bulk sampling path
+ */
+template <typename Distribution, typename = void>
+struct has_bulk_sampling : std::false_type {};
+
+template <typename Distribution>
+struct has_bulk_sampling<Distribution, compat::void_t<
+  decltype(std::declval<Distribution&>().add_to(
+        std::declval<typename Distribution::result_type*>(),
+        std::declval<typename Distribution::result_type*>(),
+        std::declval<polymorphic_generator&>())),
+  decltype(std::declval<Distribution&>().add_to(
+        std::declval<typename Distribution::result_type const*>(),
+        std::declval<typename Distribution::result_type const*>(),
+        std::declval<typename Distribution::result_type*>(),
+        std::declval<polymorphic_generator&>())),
+  decltype(std::declval<Distribution&>().fill(
+        std::declval<typename Distribution::result_type*>(),
+        std::declval<typename Distribution::result_type*>(),
+        std::declval<polymorphic_generator&>()))
+  >> : std::true_type {};
+
 template <class Impl>
 class polymorphic_distribution_impl: public polymorphic_distribution<typename Impl::result_type> {
   public:
@@ -89,6 +140,18 @@ class polymorphic_distribution_impl: public polymorphic_distribution<typename Im
     return impl(g);
   }
 
+  void fill(result_type* begin, result_type* end, polymorphic_generator &g) final {
+    fill(begin, end, g, has_bulk_sampling<Impl>{});
+  }
+
+  void add_to(result_type* begin, result_type* end, polymorphic_generator &g) final {
+    add_to(begin, end, g, has_bulk_sampling<Impl>{});
+  }
+
+  void add_to(result_type const* src_begin, result_type const* src_end, result_type* dst, polymorphic_generator &g) final {
+    add_to(src_begin, src_end, dst, g, has_bulk_sampling<Impl>{});
+  }
+
   result_type min() {return impl.min(); }
 
   result_type max() {return impl.max(); }
@@ -119,6 +182,35 @@ class polymorphic_distribution_impl: public polymorphic_distribution<typename Im
   };
 
   private:
+  void fill(result_type* begin, result_type* end, polymorphic_generator &g, std::true_type) {
+    impl.fill(begin, end, g);
+  }
+  void fill(result_type* begin, result_type* end, polymorphic_generator &g, std::false_type) {
+    buffered_generator buffered(g);
+    std::generate(begin, end, [&]{ return impl(buffered); });
+  }
+
+  void add_to(result_type* begin, result_type* end, polymorphic_generator &g, std::true_type) {
+    impl.add_to(begin, end, g);
+  }
+  void add_to(result_type* begin, result_type* end, polymorphic_generator &g, std::false_type) {
+    buffered_generator buffered(g);
+    for(; begin != end; ++begin) {
+      *begin += impl(buffered);
+    }
+  }
+
+  void add_to(result_type const* src_begin, result_type const* src_end, result_type* dst, polymorphic_generator &g, std::true_type) {
+    impl.add_to(src_begin, src_end, dst, g);
+  }
+  void add_to(result_type const* src_begin, result_type const* src_end, result_type* dst, polymorphic_generator &g, std::false_type) {
+    buffered_generator buffered(g);
+    for(; src_begin != src_end; ++src_begin, ++dst) {
+      *dst = *src_begin;
+      *dst += impl(buffered);
+    }
+  }
+
   Impl impl;
 };
 
@@ -127,6 +219,21 @@ pressio_registry<std::unique_ptr<polymorphic_generator>>& generator_registry() {
   return registry;
 }
 
+std::unique_ptr<polymorphic_generator> generator_for_block(polymorphic_generator& gen, unsigned int seed, size_t block) {
+  //each block of a counter based stream may consume up to 2**40 outputs
+  constexpr unsigned int block_stride_bits = 40;
+  auto block_gen = gen.clone();
+  if(block == 0 || (block_gen->constant_time_discard() && block < (size_t{1} << (64 - block_stride_bits)))) {
+    std::seed_seq seq{seed};
+    block_gen->seed(seq);
+    block_gen->discard(static_cast<unsigned long long>(block) << block_stride_bits);
+  } else {
+    std::seed_seq seq{seed, static_cast<unsigned int>(block), static_cast<unsigned int>(static_cast<uint64_t>(block) >> 32)};
+    block_gen->seed(seq);
+  }
+  return block_gen;
+}
+
 template <class T>
 pressio_registry<std::unique_ptr<polymorphic_distribution<T>>>& get_distribution_registry() {
   assert(false);
@@ -153,9 +260,14 @@ CREATE_REGISTRY(bool)
 
 #define RANDOM_REGISTER_STD_GENERATOR(type) \
   pressio_register type (generator_registry(), #type, []{return compat::make_unique<polymorphic_generator_impl<std::type>>(); })
+#define RANDOM_REGISTER_COUNTER_GENERATOR(type) \
+  pressio_register gen_##type (generator_registry(), #type, []{return compat::make_unique<polymorphic_generator_impl<type>>(); })
 #define RANDOM_REGISTER_REAL_STD_DISTRIBUTION(type) \
   pressio_register f_##type (get_distribution_registry<float>(), #type, []{return compat::make_unique<polymorphic_distribution_impl<std::type<float>>>(); }); \
   pressio_register d_##type (get_distribution_registry<double>(), #type, []{return compat::make_unique<polymorphic_distribution_impl<std::type<double>>>(); });
+#define RANDOM_REGISTER_REAL_DISTRIBUTION(name, type) \
+  pressio_register f_##name (get_distribution_registry<float>(), #name, []{return compat::make_unique<polymorphic_distribution_impl<type<float>>>(); }); \
+  pressio_register d_##name (get_distribution_registry<double>(), #name, []{return compat::make_unique<polymorphic_distribution_impl<type<double>>>(); });
 #define RANDOM_REGISTER_INT_STD_DISTRIBUTION(type) \
   pressio_register i8_##type (get_distribution_registry<int8_t>(), #type, []{return compat::make_unique<polymorphic_distribution_impl<std::type<int8_t>>>(); }); \
   pressio_register i16_##type (get_distribution_registry<int16_t>(), #type, []{return compat::make_unique<polymorphic_distribution_impl<std::type<int16_t>>>(); }); \
@@ -171,6 +283,8 @@ namespace {
   RANDOM_REGISTER_STD_GENERATOR(mt19937_64);
   RANDOM_REGISTER_STD_GENERATOR(ranlux48_base);
   RANDOM_REGISTER_STD_GENERATOR(knuth_b);
+  RANDOM_REGISTER_COUNTER_GENERATOR(philox4x32);
+  RANDOM_REGISTER_COUNTER_GENERATOR(threefry2x64);
   RANDOM_REGISTER_REAL_STD_DISTRIBUTION(cauchy_distribution);
   RANDOM_REGISTER_REAL_STD_DISTRIBUTION(chi_squared_distribution);
   RANDOM_REGISTER_REAL_STD_DISTRIBUTION(extreme_value_distribution);
@@ -181,6 +295,8 @@ namespace {
   RANDOM_REGISTER_REAL_STD_DISTRIBUTION(student_t_distribution);
   RANDOM_REGISTER_REAL_STD_DISTRIBUTION(weibull_distribution);
   RANDOM_REGISTER_REAL_STD_DISTRIBUTION(uniform_real_distribution);
+  RANDOM_REGISTER_REAL_DISTRIBUTION(simd_normal, simd_normal_distribution);
+  RANDOM_REGISTER_REAL_DISTRIBUTION(simd_uniform_real, simd_uniform_real_distribution);
   RANDOM_REGISTER_INT_STD_DISTRIBUTION(uniform_int_distribution);
   RANDOM_REGISTER_INT_STD_DISTRIBUTION(binomial_distribution);
   RANDOM_REGISTER_INT_STD_DISTRIBUTION(negative_binomial_distribution);
@@ -1,3 +1,8 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_RANDOM_DISTRIBUTIONS_H
+#define LIBPRESSIO_ERROR_INJECTOR_RANDOM_DISTRIBUTIONS_H
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <random>
 #include <utility>
@@ -11,15 +16,99 @@ class polymorphic_generator {
 
     virtual ~polymorphic_generator()=default;
 
+    //every generator is narrowed to produce uniform 32 bit outputs regardless of the engine's native range
     static constexpr result_type min() {
-      return std::minstd_rand::min();
+      return 0;
     }
     static constexpr result_type max() {
-      return std::minstd_rand::max();
+      return 0xFFFFFFFF;
     }
     virtual result_type operator()()=0;
+    /**
+     * fills [begin, end) with the next end-begin outputs of the generator
+     */
+    virtual void generate(result_type* begin, result_type* end)=0;
+    /**
+     * advances the generator by n outputs
+     */
+    virtual void discard(unsigned long long n)=0;
+    /**
+     * \returns true if discard runs in constant time, i.e. the generator is counter based and independent streams can
+     * be derived from a single seed by skipping ahead
+     */
+    virtual bool constant_time_discard() const=0;
     virtual void seed(std::seed_seq& seed)=0;
     virtual std::unique_ptr<polymorphic_generator> clone()=0;
+
+  protected:
+    /**
+     * moves up to end-begin outputs read ahead by buffered_generator to begin; implementations return these before
+     * any new outputs of their engine
+     *
+     * \returns the number of outputs moved
+     */
+    size_t take_read_ahead(result_type* begin, result_type* end) {
+      const size_t n = std::min<size_t>(end - begin, ahead.size() - ahead_pos);
+      std::copy(ahead.begin() + ahead_pos, ahead.begin() + ahead_pos + n, begin);
+      ahead_pos += n;
+      return n;
+    }
+    /**
+     * drops up to n outputs read ahead by buffered_generator
+     *
+     * \returns the number of outputs dropped
+     */
+    unsigned long long skip_read_ahead(unsigned long long n) {
+      const size_t skipped = static_cast<size_t>(std::min<unsigned long long>(n, ahead.size() - ahead_pos));
+      ahead_pos += skipped;
+      return skipped;
+    }
+    void clear_read_ahead() {
+      ahead_pos = ahead.size();
+    }
+    void copy_read_ahead(polymorphic_generator const& other) {
+      ahead = other.ahead;
+      ahead_pos = other.ahead_pos;
+    }
+
+  private:
+    friend class buffered_generator;
+    //outputs drawn by a buffered_generator but not yet used, they belong to the generator so they outlive the adapter
+    std::array<result_type, 256> ahead;
+    size_t ahead_pos = ahead.size();
+};
+
+/**
+ * adapts a polymorphic_generator for use by a concrete distribution
+ *
+ * outputs are requested from the underlying generator in blocks so a distribution pays one virtual call per block
+ * rather than per sample.  The block is stored in the generator and outputs left in it when the adapter is destroyed
+ * are returned by the next call on the generator, so the distribution observes the same sequence of outputs as it
+ * would calling the generator directly, however the calls are split into batches.
+ */
+class buffered_generator {
+  public:
+    using result_type = polymorphic_generator::result_type;
+
+    explicit buffered_generator(polymorphic_generator& gen): gen(gen) {}
+
+    static constexpr result_type min() {
+      return polymorphic_generator::min();
+    }
+    static constexpr result_type max() {
+      return polymorphic_generator::max();
+    }
+    result_type operator()() {
+      if(gen.ahead_pos == gen.ahead.size()) {
+        //the read ahead block is empty, so generate draws only new outputs
+        gen.generate(gen.ahead.data(), gen.ahead.data() + gen.ahead.size());
+        gen.ahead_pos = 0;
+      }
+      return gen.ahead[gen.ahead_pos++];
+    }
+
+  private:
+    polymorphic_generator& gen;
 };
 
 template <class ResultType>
@@ -30,6 +119,20 @@ class polymorphic_distribution {
   virtual ~polymorphic_distribution()=default;
 
   virtual result_type operator()(polymorphic_generator &g)=0;
+  /**
+   * overwrites [begin, end) with samples from the distribution
+   */
+  virtual void fill(result_type* begin, result_type* end, polymorphic_generator &g)=0;
+  /**
+   * adds a sample from the distribution to each element of [begin, end)
+   */
+  virtual void add_to(result_type* begin, result_type* end, polymorphic_generator &g)=0;
+  /**
+   * writes src[i] plus a sample from the distribution to dst[i] for each element of [src_begin, src_end)
+   *
+   * draws the same samples as add_to so copying and then calling add_to gives the same result in two passes
+   */
+  virtual void add_to(result_type const* src_begin, result_type const* src_end, result_type* dst, polymorphic_generator &g)=0;
   virtual result_type min()=0;
   virtual result_type max()=0;
   virtual bool operator==(polymorphic_distribution const&)const=0 ;
@@ -42,6 +145,18 @@ class polymorphic_distribution {
 
 pressio_registry<std::unique_ptr<polymorphic_generator>>& generator_registry();
 
+/**
+ * derives the independent, reproducible stream used for one block of a buffer
+ *
+ * block 0 uses the stream seeded directly from seed.  Counter based generators position later blocks by skipping
+ * ahead in the same stream, other generators are reseeded from (seed, block).
+ *
+ * \param[in] gen the generator to derive the stream from, its state is not modified
+ * \param[in] seed the seed for the whole buffer
+ * \param[in] block the index of the block
+ */
+std::unique_ptr<polymorphic_generator> generator_for_block(polymorphic_generator& gen, unsigned int seed, size_t block);
+
 template <class T> pressio_registry<std::unique_ptr<polymorphic_distribution<T>>>& get_distribution_registry();
 template <> pressio_registry<std::unique_ptr<polymorphic_distribution<double>>>& get_distribution_registry<double>();
 template <> pressio_registry<std::unique_ptr<polymorphic_distribution<float>>>& get_distribution_registry<float>();
@@ -54,3 +169,5 @@ template <> pressio_registry<std::unique_ptr<polymorphic_distribution<uint16_t>>
 template <> pressio_registry<std::unique_ptr<polymorphic_distribution<uint32_t>>>& get_distribution_registry<uint32_t>();
 template <> pressio_registry<std::unique_ptr<polymorphic_distribution<uint64_t>>>& get_distribution_registry<uint64_t>();
 template <> pressio_registry<std::unique_ptr<polymorphic_distribution<bool>>>& get_distribution_registry<bool>();
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_RANDOM_DISTRIBUTIONS_H */
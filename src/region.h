@@ -0,0 +1,171 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_REGION_H
+#define LIBPRESSIO_ERROR_INJECTOR_REGION_H
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * a selection of the elements of an N-d array, either a strided hyperslab or the non-zero elements of a mask
+ *
+ * the selected elements are numbered in memory order, so a region behaves like a compact array of size() elements and
+ * block streams can be laid over it.  Selected elements are visited as runs of evenly spaced elements along dimension
+ * 0, so loops over a run are contiguous when the stride along dimension 0 is one.
+ */
+class region {
+  public:
+  /**
+   * selects start[i] + j*stride[i] for j in [0, count[i]) along each dimension i, dimension 0 varies fastest
+   *
+   * missing entries default to a start of 0, a stride of 1, and a count reaching the end of the dimension
+   *
+   * \throws std::runtime_error if the hyperslab does not fit in dims
+   */
+  static region hyperslab(std::vector<size_t> const& dims, std::vector<size_t> start, std::vector<size_t> count,
+      std::vector<size_t> stride) {
+    if(start.size() > dims.size() || count.size() > dims.size() || stride.size() > dims.size()) {
+      throw std::runtime_error("the region of interest has more dimensions than the input");
+    }
+    start.resize(dims.size(), 0);
+    stride.resize(dims.size(), 1);
+    const size_t given_counts = count.size();
+    count.resize(dims.size());
+    region r;
+    r.pitch.resize(dims.size());
+    r.selected = dims.empty() ? 0 : 1;
+    size_t pitch = 1;
+    for (size_t i = 0; i < dims.size(); ++i) {
+      if(stride[i] == 0) throw std::runtime_error("region of interest strides must be non-zero");
+      if(start[i] > dims[i]) throw std::runtime_error("region of interest start is outside dimension " + std::to_string(i));
+      if(i >= given_counts) count[i] = (dims[i] - start[i] + stride[i] - 1) / stride[i];
+      if(count[i] > 0 && start[i] + (count[i] - 1) * stride[i] >= dims[i]) {
+        throw std::runtime_error("region of interest is outside dimension " + std::to_string(i));
+      }
+      r.pitch[i] = pitch;
+      pitch *= dims[i];
+      r.selected *= count[i];
+    }
+    r.start = std::move(start);
+    r.count = std::move(count);
+    r.stride = std::move(stride);
+    return r;
+  }
+
+  /**
+   * selects the elements where mask is non-zero
+   */
+  template <class T>
+  static region mask(T const* mask, size_t n) {
+    region r;
+    r.selected = 0;
+    for (size_t i = 0; i < n;) {
+      if(!mask[i]) {
+        ++i;
+        continue;
+      }
+      const size_t begin = i;
+      while(i < n && mask[i]) ++i;
+      r.runs.push_back(run{begin, i - begin, r.selected});
+      r.selected += i - begin;
+    }
+    return r;
+  }
+
+  /**
+   * \returns the number of selected elements
+   */
+  size_t size() const {
+    return selected;
+  }
+
+  /**
+   * calls f(offset, len, step, index) for the runs of selected elements numbered [first, first+n) in order, where the
+   * run holds the elements offset + j*step of the array for j in [0, len) and is numbered from index
+   */
+  template <class Function>
+  void for_each_run(size_t first, size_t n, Function&& f) const {
+    n = std::min(n, selected - std::min(first, selected));
+    if(n == 0) return;
+    if(pitch.empty()) {
+      for_each_mask_run(first, n, f);
+    } else {
+      for_each_hyperslab_run(first, n, f);
+    }
+  }
+
+  /**
+   * \returns the offset in the array of the element numbered index, which must be less than size()
+   *
+   * computed directly from index without allocating, since it is called once per perturbed element
+   */
+  size_t offset(size_t index) const {
+    if(pitch.empty()) {
+      const run& r = *find_run(index);
+      return r.offset + (index - r.index);
+    }
+    size_t result = 0;
+    for (size_t i = 0; i < count.size(); ++i) {
+      result += (start[i] + (index % count[i]) * stride[i]) * pitch[i];
+      index /= count[i];
+    }
+    return result;
+  }
+
+  private:
+  region()=default;
+
+  struct run {
+    size_t offset, len, index;
+  };
+
+  /**
+   * \returns the mask run holding the element numbered index
+   */
+  std::vector<run>::const_iterator find_run(size_t index) const {
+    auto it = std::upper_bound(runs.begin(), runs.end(), index, [](size_t index, run const& r) { return index < r.index; });
+    return --it;
+  }
+
+  template <class Function>
+  void for_each_mask_run(size_t first, size_t n, Function& f) const {
+    auto it = find_run(first);
+    for (size_t index = first, last = first + n; index < last; ++it) {
+      const size_t skip = index - it->index;
+      const size_t len = std::min(it->len - skip, last - index);
+      f(it->offset + skip, len, size_t{1}, index);
+      index += len;
+    }
+  }
+
+  template <class Function>
+  void for_each_hyperslab_run(size_t first, size_t n, Function& f) const {
+    std::vector<size_t> position(count.size());
+    size_t remainder = first;
+    for (size_t i = 0; i < count.size(); ++i) {
+      position[i] = remainder % count[i];
+      remainder /= count[i];
+    }
+    for (size_t index = first, last = first + n; index < last;) {
+      size_t offset = 0;
+      for (size_t i = 0; i < count.size(); ++i) {
+        offset += (start[i] + position[i] * stride[i]) * pitch[i];
+      }
+      const size_t len = std::min(count[0] - position[0], last - index);
+      f(offset, len, stride[0] * pitch[0], index);
+      index += len;
+      //advance the outer positions like an odometer
+      position[0] = 0;
+      for (size_t i = 1; i < count.size(); ++i) {
+        if(++position[i] < count[i]) break;
+        position[i] = 0;
+      }
+    }
+  }
+
+  size_t selected = 0;
+  std::vector<size_t> start, count, stride, pitch;
+  std::vector<run> runs;
+};
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_REGION_H */
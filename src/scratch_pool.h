@@ -0,0 +1,75 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_SCRATCH_POOL_H
+#define LIBPRESSIO_ERROR_INJECTOR_SCRATCH_POOL_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * a buffer of at least the requested size borrowed from a pool owned by the calling thread and returned to it when
+ * destroyed
+ *
+ * Repeated calls on a thread reuse the same allocations, so concurrent injections neither allocate nor contend on the
+ * heap in the steady state.  Nested borrows on one thread receive distinct buffers.  The contents are uninitialized.
+ *
+ * Only buffers of at most max_pooled_bytes, about the size of a block of noise, are kept when returned; larger buffers
+ * such as copies of a whole input are freed so an idle thread does not hold on to them.
+ */
+class scratch_buffer {
+  public:
+  explicit scratch_buffer(size_t bytes) {
+    auto& pool = free_buffers();
+    auto best = pool.end();
+    for (auto it = pool.begin(); it != pool.end(); ++it) {
+      if(it->first >= bytes && (best == pool.end() || it->first < best->first)) best = it;
+    }
+    if(best != pool.end()) {
+      capacity = best->first;
+      buffer = std::move(best->second);
+      pool.erase(best);
+    } else {
+      capacity = bytes;
+      buffer.reset(new uint8_t[std::max<size_t>(bytes, 1)]);
+    }
+  }
+  ~scratch_buffer() {
+    if(capacity > max_pooled_bytes) return;
+    auto& pool = free_buffers();
+    if(pool.size() >= max_free_buffers) {
+      //keep the largest buffers since they are the most expensive to allocate
+      auto smallest = std::min_element(pool.begin(), pool.end(),
+          [](entry const& lhs, entry const& rhs) { return lhs.first < rhs.first; });
+      if(smallest->first >= capacity) return;
+      pool.erase(smallest);
+    }
+    pool.emplace_back(capacity, std::move(buffer));
+  }
+  scratch_buffer(scratch_buffer const&)=delete;
+  scratch_buffer& operator=(scratch_buffer const&)=delete;
+
+  void* data() const {
+    return buffer.get();
+  }
+
+  template <class T>
+  T* as() const {
+    return reinterpret_cast<T*>(buffer.get());
+  }
+
+  private:
+  using entry = std::pair<size_t, std::unique_ptr<uint8_t[]>>;
+  static constexpr size_t max_free_buffers = 4;
+  static constexpr size_t max_pooled_bytes = size_t{1} << 24;
+
+  static std::vector<entry>& free_buffers() {
+    static thread_local std::vector<entry> pool;
+    return pool;
+  }
+
+  size_t capacity;
+  std::unique_ptr<uint8_t[]> buffer;
+};
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_SCRATCH_POOL_H */
@@ -0,0 +1,191 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "simd_distributions.h"
+
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define SIMD_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+#ifndef SIMD_TARGET_CLONES
+#define SIMD_TARGET_CLONES
+#endif
+
+/*
+ * the kernels below are written as straight line loops without data dependent branches so that each target clone is
+ * auto-vectorized for its ISA; selects are expressed with the conditional operator which lowers to blends
+ */
+namespace {
+  using simd_kernels::raw_type;
+
+  constexpr double two_pi = 6.283185307179586476925286766559;
+  constexpr double ln2 = 0.693147180559945309417232121458;
+
+  inline double bit_cast_double(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  inline uint64_t bit_cast_uint64(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  /**
+   * natural log for normal positive x, accurate to a few ulp
+   */
+  inline double log_positive(double x) {
+    //offset the bits so the mantissa is reduced to [sqrt(2)/2, sqrt(2)) without a select
+    const uint64_t bits = bit_cast_uint64(x) + (0x3FF0000000000000 - 0x3FE6A09E667F3BCD);
+    const double exponent = static_cast<double>(static_cast<int32_t>(bits >> 52) - 1023);
+    const double mantissa = bit_cast_double((bits & 0x000FFFFFFFFFFFFF) + 0x3FE6A09E667F3BCD);
+
+    //log(m) = 2 atanh(s) with |s| <= 0.172
+    const double s = (mantissa - 1.0) / (mantissa + 1.0);
+    const double s2 = s * s;
+    double series = 1.0/21.0;
+    series = series * s2 + 1.0/19.0;
+    series = series * s2 + 1.0/17.0;
+    series = series * s2 + 1.0/15.0;
+    series = series * s2 + 1.0/13.0;
+    series = series * s2 + 1.0/11.0;
+    series = series * s2 + 1.0/9.0;
+    series = series * s2 + 1.0/7.0;
+    series = series * s2 + 1.0/5.0;
+    series = series * s2 + 1.0/3.0;
+    series = series * s2 + 1.0;
+    return exponent * ln2 + 2.0 * s * series;
+  }
+
+  /**
+   * computes sin(2 pi u) and cos(2 pi u) for u in [0, 1)
+   */
+  inline void sincos_turns(double u, double& sin_out, double& cos_out) {
+    //reduce to an angle in [-pi/4, pi/4] and a quadrant
+    const int32_t quadrant = static_cast<int32_t>(u * 4.0 + 0.5);
+    const double theta = (u - static_cast<double>(quadrant) * 0.25) * two_pi;
+    const double t2 = theta * theta;
+
+    double sin_series = -1.0/1307674368000.0;
+    sin_series = sin_series * t2 + 1.0/6227020800.0;
+    sin_series = sin_series * t2 - 1.0/39916800.0;
+    sin_series = sin_series * t2 + 1.0/362880.0;
+    sin_series = sin_series * t2 - 1.0/5040.0;
+    sin_series = sin_series * t2 + 1.0/120.0;
+    sin_series = sin_series * t2 - 1.0/6.0;
+    sin_series = sin_series * t2 + 1.0;
+    const double s = theta * sin_series;
+
+    double cos_series = 1.0/20922789888000.0;
+    cos_series = cos_series * t2 - 1.0/87178291200.0;
+    cos_series = cos_series * t2 + 1.0/479001600.0;
+    cos_series = cos_series * t2 - 1.0/3628800.0;
+    cos_series = cos_series * t2 + 1.0/40320.0;
+    cos_series = cos_series * t2 - 1.0/720.0;
+    cos_series = cos_series * t2 + 1.0/24.0;
+    cos_series = cos_series * t2 - 0.5;
+    const double c = cos_series * t2 + 1.0;
+
+    //rotate by quadrant * pi/2 by swapping and negating through the bit patterns
+    const uint64_t swap = 0 - static_cast<uint64_t>(quadrant & 1);
+    const uint64_t s_bits = bit_cast_uint64(s), c_bits = bit_cast_uint64(c);
+    const uint64_t sin_bits = (s_bits & ~swap) | (c_bits & swap);
+    const uint64_t cos_bits = (c_bits & ~swap) | (s_bits & swap);
+    sin_out = bit_cast_double(sin_bits ^ (static_cast<uint64_t>(quadrant & 2) << 62));
+    cos_out = bit_cast_double(cos_bits ^ (static_cast<uint64_t>((quadrant + 1) & 2) << 62));
+  }
+
+  /*
+   * conversions go through int32_t since only signed 32 bit integers have vector conversions to floating point on every
+   * target
+   */
+  inline int32_t top_bits(raw_type raw, unsigned bits) {
+    return static_cast<int32_t>(static_cast<uint32_t>(raw) >> (32 - bits));
+  }
+
+  /**
+   * uniform in [0, 1) with the precision of RealType
+   */
+  inline float unit_uniform(float, raw_type const* raw) {
+    return static_cast<float>(top_bits(raw[0], 24)) * 0x1.0p-24f;
+  }
+  inline double unit_uniform(double, raw_type const* raw) {
+    return (static_cast<double>(top_bits(raw[0], 27)) * 0x1.0p26 + static_cast<double>(top_bits(raw[1], 26))) * 0x1.0p-53;
+  }
+
+  /**
+   * uniform in (0, 1] used for the radius of the Box-Muller transform
+   */
+  inline double unit_uniform_open(float, raw_type const* raw) {
+    return (static_cast<double>(top_bits(raw[0], 31)) + 1.0) * 0x1.0p-31;
+  }
+  inline double unit_uniform_open(double, raw_type const* raw) {
+    return 1.0 - unit_uniform(double{}, raw);
+  }
+
+  /**
+   * uniform in [0, 1) used for the angle of the Box-Muller transform
+   */
+  inline double unit_uniform_angle(float, raw_type const* raw) {
+    return static_cast<double>(top_bits(raw[0], 31)) * 0x1.0p-31;
+  }
+  inline double unit_uniform_angle(double, raw_type const* raw) {
+    return unit_uniform(double{}, raw);
+  }
+
+  template <class RealType>
+  inline void uniform_kernel(RealType* __restrict out, size_t n, raw_type const* __restrict raw, RealType a, RealType b, bool accumulate) {
+    constexpr size_t stride = simd_kernels::raws_per_sample<RealType>();
+    const RealType scale = b - a;
+    if(accumulate) {
+      for (size_t i = 0; i < n; ++i) {
+        out[i] += a + scale * unit_uniform(RealType{}, raw + i * stride);
+      }
+    } else {
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = a + scale * unit_uniform(RealType{}, raw + i * stride);
+      }
+    }
+  }
+
+  template <bool Accumulate, class RealType>
+  inline void normal_kernel(RealType* __restrict out, size_t n, raw_type const* __restrict raw, RealType mean, RealType stddev) {
+    constexpr size_t stride = simd_kernels::raws_per_sample<RealType>();
+    const size_t pairs = n / 2;
+    raw_type const* __restrict radius_raw = raw;
+    raw_type const* __restrict angle_raw = raw + pairs * stride;
+    RealType* __restrict first = out;
+    RealType* __restrict second = out + pairs;
+    for (size_t i = 0; i < pairs; ++i) {
+      const double radius = stddev * std::sqrt(-2.0 * log_positive(unit_uniform_open(RealType{}, radius_raw + i * stride)));
+      double s, c;
+      sincos_turns(unit_uniform_angle(RealType{}, angle_raw + i * stride), s, c);
+      const RealType z0 = static_cast<RealType>(mean + radius * c);
+      const RealType z1 = static_cast<RealType>(mean + radius * s);
+      first[i] = Accumulate ? first[i] + z0 : z0;
+      second[i] = Accumulate ? second[i] + z1 : z1;
+    }
+  }
+  template <class RealType>
+  inline void normal_kernel(RealType* out, size_t n, raw_type const* raw, RealType mean, RealType stddev, bool accumulate) {
+    if(accumulate) normal_kernel<true>(out, n, raw, mean, stddev);
+    else normal_kernel<false>(out, n, raw, mean, stddev);
+  }
+}
+
+namespace simd_kernels {
+  SIMD_TARGET_CLONES void uniform(float* out, size_t n, raw_type const* raw, float a, float b, bool accumulate) {
+    uniform_kernel(out, n, raw, a, b, accumulate);
+  }
+  SIMD_TARGET_CLONES void uniform(double* out, size_t n, raw_type const* raw, double a, double b, bool accumulate) {
+    uniform_kernel(out, n, raw, a, b, accumulate);
+  }
+  SIMD_TARGET_CLONES void normal(float* out, size_t n, raw_type const* raw, float mean, float stddev, bool accumulate) {
+    normal_kernel(out, n, raw, mean, stddev, accumulate);
+  }
+  SIMD_TARGET_CLONES void normal(double* out, size_t n, raw_type const* raw, double mean, double stddev, bool accumulate) {
+    normal_kernel(out, n, raw, mean, stddev, accumulate);
+  }
+}
@@ -0,0 +1,227 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_SIMD_DISTRIBUTIONS_H
+#define LIBPRESSIO_ERROR_INJECTOR_SIMD_DISTRIBUTIONS_H
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include "random_distributions.h"
+
+/**
+ * \file
+ * real distributions with branch free bulk sampling kernels
+ *
+ * Unlike their std:: counterparts, these distributions draw a fixed number of generator outputs per sample so a
+ * buffer of samples can be computed lane-wise.  The kernels are compiled for AVX-512, AVX2, and the baseline ISA and
+ * the best supported version is selected at load time where the compiler supports it.
+ */
+
+namespace simd_kernels {
+  using raw_type = polymorphic_generator::result_type;
+
+  /**
+   * the number of generator outputs consumed per sample: 24 bits of entropy for float, 53 bits for double
+   */
+  template <class RealType>
+  constexpr size_t raws_per_sample() {
+    return std::numeric_limits<RealType>::digits > 32 ? 2 : 1;
+  }
+
+  /**
+   * computes out[i] (+)= a + (b-a) * U[0,1) for i in [0,n) from n*raws_per_sample<T>() generator outputs
+   */
+  void uniform(float* out, size_t n, raw_type const* raw, float a, float b, bool accumulate);
+  void uniform(double* out, size_t n, raw_type const* raw, double a, double b, bool accumulate);
+
+  /**
+   * computes out[i] (+)= mean + stddev * N(0,1) for i in [0,n) from n*raws_per_sample<T>() generator outputs using the
+   * Box-Muller transform; n must be even
+   */
+  void normal(float* out, size_t n, raw_type const* raw, float mean, float stddev, bool accumulate);
+  void normal(double* out, size_t n, raw_type const* raw, double mean, double stddev, bool accumulate);
+}
+
+/**
+ * common implementation of the bulk sampling path for distributions built on simd_kernels
+ *
+ * Derived provides sample(out, n, raw, accumulate) which evaluates its kernel on n samples, n is even, and
+ * take_saved(value) which moves a sample left over by a scalar call into value and returns true if there was one
+ */
+template <class Derived, class RealType>
+class simd_real_distribution {
+  public:
+  using result_type = RealType;
+
+  void fill(result_type* begin, result_type* end, polymorphic_generator& g) {
+    apply(begin, end, g, false);
+  }
+  void add_to(result_type* begin, result_type* end, polymorphic_generator& g) {
+    apply(begin, end, g, true);
+  }
+  void add_to(result_type const* src_begin, result_type const* src_end, result_type* dst, polymorphic_generator& g) {
+    apply(dst, dst + (src_end - src_begin), g, true, src_begin);
+  }
+
+  protected:
+  static constexpr size_t chunk_size = 256;
+  static constexpr size_t raws_per_sample = simd_kernels::raws_per_sample<RealType>();
+
+  template <class Generator>
+  static void draw(simd_kernels::raw_type* begin, simd_kernels::raw_type* end, Generator& g) {
+    for (; begin != end; ++begin) {
+      *begin = g();
+    }
+  }
+  static void draw(simd_kernels::raw_type* begin, simd_kernels::raw_type* end, polymorphic_generator& g) {
+    g.generate(begin, end);
+  }
+
+  private:
+  /**
+   * evaluates the kernel over [begin, end) in chunks; if src is provided each chunk is first copied from src so the
+   * copy and the accumulation happen while the chunk is in cache
+   */
+  void apply(result_type* begin, result_type* end, polymorphic_generator& g, bool accumulate, result_type const* src = nullptr) {
+    //a sample left over by operator() is used first so it is neither lost nor returned after the samples drawn here
+    result_type saved;
+    if(begin != end && static_cast<Derived*>(this)->take_saved(saved)) {
+      if(src) *begin = *src++;
+      if(accumulate) *begin += saved;
+      else *begin = saved;
+      ++begin;
+    }
+    std::array<simd_kernels::raw_type, chunk_size * raws_per_sample> raw;
+    while(end - begin >= 2) {
+      const size_t n = std::min<size_t>(chunk_size, static_cast<size_t>(end - begin) & ~size_t{1});
+      if(src) {
+        std::copy(src, src + n, begin);
+        src += n;
+      }
+      g.generate(raw.data(), raw.data() + n * raws_per_sample);
+      static_cast<Derived*>(this)->sample(begin, n, raw.data(), accumulate);
+      begin += n;
+    }
+    if(begin != end) {
+      if(src) *begin = *src;
+      if(accumulate) *begin += (*static_cast<Derived*>(this))(g);
+      else *begin = (*static_cast<Derived*>(this))(g);
+    }
+  }
+};
+
+/**
+ * uniform real distribution over [a, b) with a vectorized bulk path
+ */
+template <class RealType>
+class simd_uniform_real_distribution: public simd_real_distribution<simd_uniform_real_distribution<RealType>, RealType> {
+  using base = simd_real_distribution<simd_uniform_real_distribution<RealType>, RealType>;
+  friend base;
+  public:
+  using result_type = RealType;
+  struct param_type {
+    using distribution_type = simd_uniform_real_distribution;
+    explicit param_type(RealType a = 0, RealType b = 1): a_(a), b_(b) {}
+    RealType a() const { return a_; }
+    RealType b() const { return b_; }
+    bool operator==(param_type const& rhs) const { return a_ == rhs.a_ && b_ == rhs.b_; }
+    bool operator!=(param_type const& rhs) const { return !(*this == rhs); }
+    private:
+    RealType a_, b_;
+  };
+
+  explicit simd_uniform_real_distribution(RealType a = 0, RealType b = 1): params(a, b) {}
+  explicit simd_uniform_real_distribution(param_type const& params): params(params) {}
+
+  template <class Generator>
+  result_type operator()(Generator& g) {
+    std::array<simd_kernels::raw_type, base::raws_per_sample> raw;
+    base::draw(raw.data(), raw.data() + raw.size(), g);
+    result_type value;
+    simd_kernels::uniform(&value, 1, raw.data(), params.a(), params.b(), false);
+    return value;
+  }
+
+  result_type min() const { return params.a(); }
+  result_type max() const { return params.b(); }
+  param_type param() const { return params; }
+  void param(param_type const& p) { params = p; }
+  void reset() {}
+  bool operator==(simd_uniform_real_distribution const& rhs) const { return params == rhs.params; }
+  bool operator!=(simd_uniform_real_distribution const& rhs) const { return !(*this == rhs); }
+
+  private:
+  void sample(result_type* out, size_t n, simd_kernels::raw_type const* raw, bool accumulate) {
+    simd_kernels::uniform(out, n, raw, params.a(), params.b(), accumulate);
+  }
+  bool take_saved(result_type&) {
+    return false;
+  }
+  param_type params;
+};
+
+/**
+ * normal distribution with a vectorized Box-Muller bulk path
+ *
+ * the magnitude of samples is bounded by roughly 8.6 stddev for double and 6.7 stddev for float by the resolution of
+ * the underlying uniform samples
+ */
+template <class RealType>
+class simd_normal_distribution: public simd_real_distribution<simd_normal_distribution<RealType>, RealType> {
+  using base = simd_real_distribution<simd_normal_distribution<RealType>, RealType>;
+  friend base;
+  public:
+  using result_type = RealType;
+  struct param_type {
+    using distribution_type = simd_normal_distribution;
+    explicit param_type(RealType mean = 0, RealType stddev = 1): mean_(mean), stddev_(stddev) {}
+    RealType mean() const { return mean_; }
+    RealType stddev() const { return stddev_; }
+    bool operator==(param_type const& rhs) const { return mean_ == rhs.mean_ && stddev_ == rhs.stddev_; }
+    bool operator!=(param_type const& rhs) const { return !(*this == rhs); }
+    private:
+    RealType mean_, stddev_;
+  };
+
+  explicit simd_normal_distribution(RealType mean = 0, RealType stddev = 1): params(mean, stddev) {}
+  explicit simd_normal_distribution(param_type const& params): params(params) {}
+
+  template <class Generator>
+  result_type operator()(Generator& g) {
+    if(has_saved) {
+      has_saved = false;
+      return saved;
+    }
+    std::array<simd_kernels::raw_type, 2 * base::raws_per_sample> raw;
+    base::draw(raw.data(), raw.data() + raw.size(), g);
+    result_type values[2];
+    simd_kernels::normal(values, 2, raw.data(), params.mean(), params.stddev(), false);
+    saved = values[1];
+    has_saved = true;
+    return values[0];
+  }
+
+  result_type min() const { return std::numeric_limits<RealType>::lowest(); }
+  result_type max() const { return std::numeric_limits<RealType>::max(); }
+  param_type param() const { return params; }
+  void param(param_type const& p) { params = p; reset(); }
+  void reset() { has_saved = false; }
+  bool operator==(simd_normal_distribution const& rhs) const {
+    return params == rhs.params && has_saved == rhs.has_saved && (!has_saved || saved == rhs.saved);
+  }
+  bool operator!=(simd_normal_distribution const& rhs) const { return !(*this == rhs); }
+
+  private:
+  void sample(result_type* out, size_t n, simd_kernels::raw_type const* raw, bool accumulate) {
+    simd_kernels::normal(out, n, raw, params.mean(), params.stddev(), accumulate);
+  }
+  bool take_saved(result_type& value) {
+    if(!has_saved) return false;
+    has_saved = false;
+    value = saved;
+    return true;
+  }
+  param_type params;
+  result_type saved = 0;
+  bool has_saved = false;
+};
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_SIMD_DISTRIBUTIONS_H */
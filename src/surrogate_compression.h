@@ -0,0 +1,263 @@
+#ifndef LIBPRESSIO_ERROR_INJECTOR_SURROGATE_COMPRESSION_H
+#define LIBPRESSIO_ERROR_INJECTOR_SURROGATE_COMPRESSION_H
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "error_stats.h"
+#include "parallel_for.h"
+
+/**
+ * \file
+ * emulates the errors of error bounded lossy compressors without compressing
+ *
+ * each function writes the reconstruction of src to dst in a single pass over blocks of elements on nthreads threads,
+ * dst may be src.  If stats is not null, the error of each parallel task is accumulated into its own element of stats
+ * while the task's output is in cache.
+ */
+
+/**
+ * rounds x to the nearest integer with two additions, unlike std::floor this vectorizes without -fno-trapping-math
+ *
+ * the result is inexact when |x| >= 2^51, callers detect this by checking the error of the reconstruction
+ */
+inline double round_bin(double x) {
+  constexpr double magic = 6755399441055744.0; //1.5 * 2^52
+  return (x + magic) - magic;
+}
+
+/**
+ * \returns value rounded to the nearest point of a grid of width step through anchor, inverse is 1 / step
+ */
+template <class T>
+T grid_point(double value, double anchor, double inverse, double step) {
+  return static_cast<T>(anchor + round_bin((value - anchor) * inverse) * step);
+}
+
+/**
+ * \returns true if value is stored exactly because its grid point, computed as by grid_point, is outside the bound
+ */
+template <class T>
+bool off_grid(T value, double anchor, double bound, double inverse, double step) {
+  const double exact = static_cast<double>(value);
+  return !(std::fabs(static_cast<double>(grid_point<T>(exact, anchor, inverse, step)) - exact) <= bound);
+}
+
+/**
+ * reconstructs the n elements of src on a grid of width step through anchor, storing elements whose reconstruction
+ * rounds outside the bound exactly
+ */
+template <class T>
+void quantize_range(T const* src, T* dst, size_t n, double anchor, double bound, double step) {
+  const double inverse = 1 / step;
+  for (size_t i = 0; i < n; ++i) {
+    const double value = static_cast<double>(src[i]);
+    const T reconstructed = grid_point<T>(value, anchor, inverse, step);
+    dst[i] = (std::fabs(static_cast<double>(reconstructed) - value) <= bound) ? reconstructed : src[i];
+  }
+}
+
+/**
+ * runs kernel(in, out, offset, len) over each block of n elements on nthreads threads, accumulating the error of block
+ * i into (*stats)[i] if stats is not null
+ */
+template <class T, class Kernel>
+void for_each_surrogate_block(T const* src, T* dst, size_t n, size_t block, unsigned int nthreads,
+    std::vector<error_stats>* stats, Kernel const& kernel) {
+  const size_t blocks = (n + block - 1) / block;
+  if(stats != nullptr) stats->assign(blocks, error_stats{});
+  parallel_for(blocks, nthreads, [&](size_t i) {
+    const size_t begin = i * block;
+    transform_chunks(src + begin, dst + begin, std::min(block, n - begin), (stats != nullptr) ? &(*stats)[i] : nullptr, kernel);
+  });
+}
+
+/**
+ * uniform scalar quantization with bins of width 2*bound, the error of each element is at most bound
+ */
+template <class T>
+void surrogate_quantize(T const* src, T* dst, size_t n, double bound, size_t block, unsigned int nthreads,
+    std::vector<error_stats>* stats = nullptr) {
+  for_each_surrogate_block(src, dst, n, block, nthreads, stats, [bound](T const* in, T* out, size_t, size_t len) {
+    quantize_range(in, out, len, 0.0, bound, 2 * bound);
+  });
+}
+
+/**
+ * the state of surrogate_predict at the end of a row that continues in the next call
+ */
+struct predict_carry {
+  //true if the next call starts in the middle of a row
+  bool active = false;
+  //the last exactly stored element and the last reconstructed element of the row
+  double anchor = 0, previous = 0;
+};
+
+/**
+ * reconstructs one row of a previous value predictor with quantized residuals, see surrogate_predict
+ *
+ * if carry is active the row continues a row from a previous call, and carry is updated with the state at its end
+ */
+template <class T>
+void predict_row(T const* src, T* dst, size_t n, double bound, predict_carry* carry = nullptr) {
+  constexpr double max_bin = 1 << 15;
+  constexpr size_t chunk = 256, min_chunk = 1;
+  const double step = 2 * bound;
+  const double inverse = 1 / step;
+  if(n == 0) return;
+  double anchor, previous;
+  //an element is stored exactly if its residual needs too many bins or if quantize_range stored it because its grid
+  //point is outside the bound; a reconstruction only equals the original then or when the grid point is exact
+  auto predictable = [&](T value, T reconstructed) {
+    return std::fabs((static_cast<double>(reconstructed) - previous) * inverse) < max_bin &&
+      (reconstructed != value || !off_grid(value, anchor, bound, inverse, step));
+  };
+  //chunks are reconstructed into out and only the predictable prefix is kept, so src is intact when dst is src
+  std::array<T, chunk> out;
+  size_t i = 0;
+  if(carry != nullptr && carry->active) {
+    anchor = carry->anchor;
+    previous = carry->previous;
+  } else {
+    dst[0] = src[0];
+    anchor = previous = static_cast<double>(src[0]);
+    i = 1;
+  }
+  //chunks shrink after an exactly stored element so dense runs of them do not recompute long chunks
+  size_t width = chunk;
+  while(i < n) {
+    const size_t len = std::min(n - i, width);
+    quantize_range(src + i, out.data(), len, anchor, bound, step);
+    size_t j = 0;
+    for (; j < len && predictable(src[i + j], out[j]); ++j) {
+      previous = static_cast<double>(out[j]);
+    }
+    std::copy(out.begin(), out.begin() + j, dst + i);
+    if(j < len) {
+      dst[i + j] = src[i + j];
+      anchor = previous = static_cast<double>(src[i + j]);
+      ++j;
+      width = min_chunk;
+    } else {
+      width = std::min(chunk, 2 * width);
+    }
+    i += j;
+  }
+  if(carry != nullptr) *carry = predict_carry{true, anchor, previous};
+}
+
+/**
+ * quantizes the residuals of a previous value predictor along rows of row_length elements like a prediction based
+ * compressor, the error of each element is at most bound
+ *
+ * The first element of each row is stored exactly.  Because predictions are reconstructed values, reconstructions lie
+ * on a grid of width 2*bound anchored at the last exactly stored element, so they are computed a chunk at a time
+ * without a serial dependency.  An element whose residual needs 2^16 or more bins, or whose grid point rounds outside
+ * the bound in T, is stored exactly and re-anchors the grid for the rest of the row.  Groups of rows are processed in
+ * parallel and the error of group i is accumulated into (*stats)[i + 1] if stats is not null, (*stats)[0] holds the
+ * error of the rest of a row begun in a previous call.
+ *
+ * A long input may be reconstructed over several calls: src starts row_offset elements into a row, and if carry is not
+ * null it holds the state at the end of the previous call on entry and at the end of this call on return, so the
+ * result is the same as reconstructing the whole input at once.
+ */
+template <class T>
+void surrogate_predict(T const* src, T* dst, size_t n, double bound, size_t row_length, unsigned int nthreads,
+    std::vector<error_stats>* stats = nullptr, size_t row_offset = 0, predict_carry* carry = nullptr) {
+  row_length = std::max<size_t>(row_length, 1);
+  //the rest of a row begun in a previous call is predicted first, the remaining rows start at head
+  const size_t head = std::min(n, (row_length - row_offset % row_length) % row_length);
+  const size_t rows = (n - head + row_length - 1) / row_length;
+  const size_t rows_per_task = std::max<size_t>(1, (size_t{1} << 16) / row_length);
+  const size_t tasks = (rows + rows_per_task - 1) / rows_per_task;
+  predict_carry incoming = (carry != nullptr) ? *carry : predict_carry{};
+  predict_carry outgoing;
+  if(stats != nullptr) stats->assign(tasks + 1, error_stats{});
+  //the last row of this call continues in the next call if it is cut short
+  const bool continues = (row_offset + n) % row_length != 0;
+  auto predict = [&](size_t begin, size_t len, predict_carry* row_carry, T* reconstructed, error_stats* row_stats) {
+    predict_carry state = (begin == 0 && head > 0) ? incoming : predict_carry{};
+    if(row_stats == nullptr) {
+      predict_row(src + begin, dst + begin, len, bound, &state);
+    } else {
+      //rows are predicted out of place so the original is still available when dst is src
+      predict_row(src + begin, reconstructed, len, bound, &state);
+      for (size_t offset = 0; offset < len; offset += error_stats::chunk_size) {
+        row_stats->add(src + begin + offset, reconstructed + offset, std::min(error_stats::chunk_size, len - offset));
+      }
+      std::copy(reconstructed, reconstructed + len, dst + begin);
+    }
+    if(row_carry != nullptr) *row_carry = state;
+  };
+
+  if(head > 0) {
+    std::unique_ptr<T[]> reconstructed((stats != nullptr) ? new T[head] : nullptr);
+    predict(0, head, (head == n && continues) ? &outgoing : nullptr, reconstructed.get(),
+        (stats != nullptr) ? &(*stats)[0] : nullptr);
+  }
+  parallel_for(tasks, nthreads, [&](size_t task) {
+    const size_t last_row = std::min(rows, (task + 1) * rows_per_task);
+    std::unique_ptr<T[]> reconstructed((stats != nullptr) ? new T[row_length] : nullptr);
+    for (size_t row = task * rows_per_task; row < last_row; ++row) {
+      const size_t begin = head + row * row_length, len = std::min(row_length, n - begin);
+      predict(begin, len, (row + 1 == rows && continues) ? &outgoing : nullptr, reconstructed.get(),
+          (stats != nullptr) ? &(*stats)[task + 1] : nullptr);
+    }
+  });
+  if(carry != nullptr && n > 0) *carry = outgoing;
+}
+
+namespace surrogate_compression_detail {
+  template <class T> struct ieee_bits;
+  template <> struct ieee_bits<float> {
+    using word = uint32_t;
+    static constexpr int mantissa = 23;
+  };
+  template <> struct ieee_bits<double> {
+    using word = uint64_t;
+    static constexpr int mantissa = 52;
+  };
+
+  template <class T>
+  void truncate(T const* src, T* dst, size_t n, double bound, size_t block, unsigned int nthreads,
+      std::vector<error_stats>* stats, std::true_type) {
+    using word = typename ieee_bits<T>::word;
+    //keeping k mantissa bits bounds the relative error by 2^-k
+    const int keep = (bound > 0) ? std::min<double>(ieee_bits<T>::mantissa, std::max(0.0, std::ceil(-std::log2(bound))))
+      : ieee_bits<T>::mantissa;
+    const word mask = static_cast<word>(~((word{1} << (ieee_bits<T>::mantissa - keep)) - 1));
+    for_each_surrogate_block(src, dst, n, block, nthreads, stats, [mask](T const* in, T* out, size_t, size_t len) {
+      for (size_t j = 0; j < len; ++j) {
+        word bits;
+        std::memcpy(&bits, in + j, sizeof(bits));
+        bits &= mask;
+        std::memcpy(out + j, &bits, sizeof(bits));
+      }
+    });
+  }
+  template <class T>
+  void truncate(T const*, T*, size_t, double, size_t, unsigned int, std::vector<error_stats>*, std::false_type) {
+    throw std::runtime_error("truncate requires float or double data");
+  }
+}
+
+/**
+ * zeros the low order mantissa bits of each element, keeping enough bits that the relative error of each element is at
+ * most bound
+ *
+ * \throws std::runtime_error if T is not float or double
+ */
+template <class T>
+void surrogate_truncate(T const* src, T* dst, size_t n, double bound, size_t block, unsigned int nthreads,
+    std::vector<error_stats>* stats = nullptr) {
+  surrogate_compression_detail::truncate(src, dst, n, bound, block, nthreads, stats,
+      std::integral_constant<bool, std::is_same<T, float>::value || std::is_same<T, double>::value>{});
+}
+
+#endif /* end of include guard: LIBPRESSIO_ERROR_INJECTOR_SURROGATE_COMPRESSION_H */
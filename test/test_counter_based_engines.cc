@@ -0,0 +1,129 @@
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include "counter_based_engines.h"
+
+/**
+ * \file
+ * checks the counter based engines against the known answers of the Random123 reference implementation and checks
+ * that constant time discard lands on the same output as advancing one output at a time
+ */
+
+namespace {
+  using words = std::array<uint32_t, 4>;
+
+  /**
+   * \returns a 2x64 counter or key as the four 32 bit words threefry2x64_bijection takes, low word first
+   */
+  words from_64(uint64_t first, uint64_t second) {
+    return {static_cast<uint32_t>(first), static_cast<uint32_t>(first >> 32),
+      static_cast<uint32_t>(second), static_cast<uint32_t>(second >> 32)};
+  }
+
+  template <class Bijection>
+  bool check_kat(const char* name, words const& ctr, words const& key, words const& expected) {
+    const words actual = Bijection::apply(ctr, key);
+    if(actual != expected) {
+      std::fprintf(stderr, "%s: got %08x %08x %08x %08x, expected %08x %08x %08x %08x\n", name,
+          actual[0], actual[1], actual[2], actual[3], expected[0], expected[1], expected[2], expected[3]);
+      return false;
+    }
+    return true;
+  }
+
+  bool test_philox_kat() {
+    //counter = 0 key = 0, counter and key all ones, and the digits of pi from Random123's kat_vectors
+    return check_kat<philox4x32_bijection>("philox4x32 zero", {0, 0, 0, 0}, {0, 0, 0, 0},
+          {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}) &
+      check_kat<philox4x32_bijection>("philox4x32 ones", {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+          {0xffffffff, 0xffffffff, 0, 0}, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}) &
+      check_kat<philox4x32_bijection>("philox4x32 pi", {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+          {0xa4093822, 0x299f31d0, 0, 0}, {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+  }
+
+  bool test_threefry_kat() {
+    const uint64_t ones = std::numeric_limits<uint64_t>::max();
+    return check_kat<threefry2x64_bijection>("threefry2x64 zero", from_64(0, 0), from_64(0, 0),
+          from_64(0xc2b6e3a8c2c69865, 0x6f81ed42f350084d)) &
+      check_kat<threefry2x64_bijection>("threefry2x64 ones", from_64(ones, ones), from_64(ones, ones),
+          from_64(0xe02cb7c4d95d277a, 0xd06633d0893b8b68)) &
+      check_kat<threefry2x64_bijection>("threefry2x64 pi", from_64(0x243f6a8885a308d3, 0x13198a2e03707344),
+          from_64(0xa4093822299f31d0, 0x082efa98ec4e6c89), from_64(0x263c7d30bb0f0af1, 0x56be8361d3311526));
+  }
+
+  /**
+   * \returns true if engine's next outputs are the outputs of Bijection at counter onwards, starting at word first
+   */
+  template <class Bijection, class Engine>
+  bool outputs_match(Engine& engine, words counter, words const& key, unsigned first, const char* what) {
+    const words block = Bijection::apply(counter, key);
+    for (unsigned i = first; i < 4; ++i) {
+      if(engine() != block[i]) {
+        std::cerr << what << ": output " << i << " of the block does not match the bijection" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class Bijection>
+  bool check_discard(const char* name) {
+    using engine_type = counter_based_engine<Bijection>;
+    const unsigned long long seed = 0x0123456789abcdef;
+    const words key = {0x89abcdef, 0x01234567, 0, 0};
+    bool passed = true;
+
+    //outputs are the words of the bijection applied to consecutive counters
+    engine_type engine(seed);
+    passed &= outputs_match<Bijection>(engine, {0, 0, 0, 0}, key, 0, name);
+    passed &= outputs_match<Bijection>(engine, {1, 0, 0, 0}, key, 0, name);
+
+    //constant time discard agrees with advancing one output at a time
+    for (unsigned long long n : {0ull, 1ull, 3ull, 4ull, 5ull, 1023ull, 100003ull}) {
+      engine_type skipped(seed), stepped(seed);
+      skipped.discard(n);
+      for (unsigned long long i = 0; i < n; ++i) stepped();
+      for (int i = 0; i < 16; ++i) {
+        if(skipped() != stepped()) {
+          std::cerr << name << ": discard(" << n << ") differs from " << n << " calls" << std::endl;
+          passed = false;
+          break;
+        }
+      }
+    }
+
+    //discarding past 2^64 outputs carries into the high half of the counter
+    engine_type carried(seed);
+    carried.discard(std::numeric_limits<unsigned long long>::max());
+    carried.discard(1);
+    passed &= outputs_match<Bijection>(carried, {0, 0x40000000, 0, 0}, key, 0, name);
+    engine_type offset(seed);
+    offset.discard(4 * 0x1234567ull + 2);
+    passed &= outputs_match<Bijection>(offset, {0x1234567, 0, 0, 0}, key, 2, name);
+    return passed;
+  }
+
+  bool test_discard() {
+    return check_discard<philox4x32_bijection>("philox4x32") & check_discard<threefry2x64_bijection>("threefry2x64");
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const std::map<std::string, bool(*)()> tests {
+    {"philox_kat", test_philox_kat},
+    {"threefry_kat", test_threefry_kat},
+    {"discard", test_discard},
+  };
+  auto test = (argc == 2) ? tests.find(argv[1]) : tests.end();
+  if(test == tests.end()) {
+    std::cerr << "usage: " << argv[0] << " test, where test is one of";
+    for (auto const& name : tests) std::cerr << ' ' << name.first;
+    std::cerr << std::endl;
+    return 1;
+  }
+  return test->second() ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "expression.h"
+
+/**
+ * \file
+ * checks the parsing and evaluation of compiled_expression against values computed directly
+ */
+
+namespace {
+  const double pi = std::acos(-1.0), e = std::exp(1.0);
+
+  /**
+   * \returns the value of source at every point of a grid of dims in memory order, evaluated a chunk of a row at a time
+   * like generate_data_from_function
+   */
+  std::vector<double> evaluate_grid(std::string const& source, std::vector<size_t> const& dims) {
+    const compiled_expression expression(source, dims);
+    auto work = expression.make_workspace();
+    size_t n = 1;
+    for (size_t dim : dims) n *= dim;
+    std::vector<double> values(n);
+    std::vector<double> coordinates(dims.size(), 0.0);
+    for (size_t row = 0; row < n / dims.front(); ++row) {
+      size_t index = row;
+      for (size_t d = 1; d < dims.size(); ++d) {
+        coordinates[d] = static_cast<double>(index % dims[d]);
+        index /= dims[d];
+      }
+      for (size_t x = 0; x < dims.front(); x += compiled_expression::chunk_size) {
+        coordinates[0] = static_cast<double>(x);
+        const size_t len = std::min(compiled_expression::chunk_size, dims.front() - x);
+        expression.evaluate(work, coordinates.data(), len, values.data() + row * dims.front() + x, x == 0);
+      }
+    }
+    return values;
+  }
+
+  /**
+   * \returns true if source evaluates to expected at every point of a grid of dims, expected is called with the
+   * coordinates of each point
+   */
+  bool evaluates_to(std::string const& source, std::vector<size_t> const& dims,
+      std::function<double(std::vector<double> const&)> const& expected) {
+    std::vector<double> values;
+    try {
+      values = evaluate_grid(source, dims);
+    } catch (std::invalid_argument const& error) {
+      std::cerr << source << " failed to compile: " << error.what() << std::endl;
+      return false;
+    }
+    std::vector<double> coordinates(dims.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      size_t index = i;
+      for (size_t d = 0; d < dims.size(); ++d) {
+        coordinates[d] = static_cast<double>(index % dims[d]);
+        index /= dims[d];
+      }
+      const double value = expected(coordinates);
+      if(!(std::fabs(values[i] - value) <= 1e-12 * std::max(1.0, std::fabs(value)))) {
+        std::cerr << source << " is " << values[i] << " at element " << i << ", expected " << value << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool constant(std::string const& source, double expected) {
+    return evaluates_to(source, {3}, [expected](std::vector<double> const&) { return expected; });
+  }
+
+  bool test_precedence() {
+    return constant("1 + 2 * 3", 7) & constant("(1 + 2) * 3", 9) & constant("10 - 4 - 3", 3) &
+      constant("8 / 4 / 2", 1) & constant("2 * 3 ^ 2", 18) & constant("2 ^ 3 ^ 2", 512) &
+      constant("1 + 6 / 2 * 3 - 2 ^ 2", 6) & constant("max(1, 2) * min(3, 4) + mod(7, 4)", 9) &
+      evaluates_to("x * 2 + 1", {5}, [](std::vector<double> const& c) { return c[0] * 2 + 1; }) &
+      evaluates_to("1 + x ^ 2 / 4", {5}, [](std::vector<double> const& c) { return 1 + c[0] * c[0] / 4; });
+  }
+
+  bool test_unary_minus() {
+    //negation binds looser than ^, so -2^2 is -(2^2), and an exponent may be negated
+    return constant("-2 ^ 2", -4) & constant("(-2) ^ 2", 4) & constant("2 ^ -1", 0.5) & constant("--3", 3) &
+      constant("3 * -2", -6) & constant("+4 - -1", 5) &
+      evaluates_to("-x", {5}, [](std::vector<double> const& c) { return -c[0]; }) &
+      evaluates_to("-x ^ 2", {5}, [](std::vector<double> const& c) { return -c[0] * c[0]; }) &
+      evaluates_to("1 - -y", {2, 3}, [](std::vector<double> const& c) { return 1 + c[1]; });
+  }
+
+  bool test_names() {
+    const std::vector<size_t> dims {4, 3, 2, 5};
+    auto place_values = [](std::vector<double> const& c) { return c[0] + 10 * c[1] + 100 * c[2] + 1000 * c[3]; };
+    return evaluates_to("x + 10 * y + 100 * z + 1000 * w", dims, place_values) &
+      evaluates_to("x0 + 10 * x1 + 100 * x2 + 1000 * x3", dims, place_values) &
+      evaluates_to("n0 + 10 * n1 + 100 * n2 + 1000 * n3", dims, [](std::vector<double> const&) { return 5234; }) &
+      evaluates_to("x / n0 + pi - e", dims, [](std::vector<double> const& c) { return c[0] / 4 + pi - e; });
+  }
+
+  /**
+   * \returns true if compiling source fails with a message giving the expected position
+   */
+  bool fails_at(std::string const& source, size_t position, std::vector<size_t> const& dims = {3}) {
+    try {
+      compiled_expression expression(source, dims);
+    } catch (std::invalid_argument const& error) {
+      const std::string expected = "at position " + std::to_string(position) + " of";
+      if(std::string(error.what()).find(expected) != std::string::npos) return true;
+      std::cerr << source << " failed with \"" << error.what() << "\", expected position " << position << std::endl;
+      return false;
+    }
+    std::cerr << source << " compiled, expected a syntax error" << std::endl;
+    return false;
+  }
+
+  bool test_syntax_errors() {
+    return fails_at("1 + * 2", 4) & fails_at("sin(x", 5) & fails_at("1 +", 3) & fails_at("(1 + 2", 6) &
+      fails_at("2 $ 3", 2) & fails_at("foo(1)", 0) & fails_at("1 + bar", 4) & fails_at("x + y", 4, {3}) &
+      fails_at("n2", 0, {3, 4}) & fails_at("pow(1)", 5) & fails_at("1 2", 2);
+  }
+
+  bool test_field() {
+    //rows longer than a chunk, so x0 crosses chunks of a row whose other coordinates are unchanged
+    const std::vector<size_t> dims {600, 7, 3};
+    return evaluates_to("sin(2*pi*x/n0) + exp(-((x-n0/2)^2 + (y-n1/2)^2)/100) + 0.01*z - atan2(y + 1, x + 1)*sqrt(abs(x - z))",
+        dims, [](std::vector<double> const& c) {
+      const double x = c[0], y = c[1], z = c[2];
+      return std::sin(2 * pi * x / 600) + std::exp(-(std::pow(x - 300, 2) + std::pow(y - 3.5, 2)) / 100) + 0.01 * z -
+        std::atan2(y + 1, x + 1) * std::sqrt(std::fabs(x - z));
+    });
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const std::map<std::string, bool(*)()> tests {
+    {"precedence", test_precedence},
+    {"unary_minus", test_unary_minus},
+    {"names", test_names},
+    {"syntax_errors", test_syntax_errors},
+    {"field", test_field},
+  };
+  auto test = (argc == 2) ? tests.find(argv[1]) : tests.end();
+  if(test == tests.end()) {
+    std::cerr << "usage: " << argv[0] << " test, where test is one of";
+    for (auto const& name : tests) std::cerr << ' ' << name.first;
+    std::cerr << std::endl;
+    return 1;
+  }
+  return test->second() ? 0 : 1;
+}
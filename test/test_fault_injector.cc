@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "libpressio_ext/cpp/libpressio.h"
+#include "libpressio_error_injector.h"
+
+/**
+ * \file
+ * checks the faults fault_injector applies to the output of a noop child, whose compressed buffer is the input itself
+ *
+ * The case to run is the first argument so each is its own ctest case.
+ */
+
+namespace {
+  /**
+   * \returns n bytes of data that are the same on every run
+   */
+  pressio_data random_bytes(size_t n) {
+    pressio_data data = pressio_data::owning(pressio_uint8_dtype, {n});
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<unsigned int> byte(0, 255);
+    uint8_t* bytes = static_cast<uint8_t*>(data.data());
+    for (size_t i = 0; i < n; ++i) bytes[i] = static_cast<uint8_t>(byte(gen));
+    return data;
+  }
+
+  /**
+   * compresses input with a new fault_injector configured by options into output
+   *
+   * \returns false and prints the error if compression fails
+   */
+  bool inject(pressio& library, pressio_options const& options, pressio_data const& input, pressio_data& output,
+      pressio_options* metrics = nullptr) {
+    pressio_compressor compressor = library.get_compressor("fault_injector");
+    if(!compressor) {
+      std::cerr << "fault_injector is not registered: " << library.err_msg() << std::endl;
+      return false;
+    }
+    if(compressor->set_options(options)) {
+      std::cerr << "set_options failed: " << compressor->error_msg() << std::endl;
+      return false;
+    }
+    output = pressio_data::empty(pressio_byte_dtype, {});
+    if(compressor->compress(&input, &output)) {
+      std::cerr << "compress failed: " << compressor->error_msg() << std::endl;
+      return false;
+    }
+    if(metrics != nullptr) *metrics = compressor->get_metrics_results();
+    return true;
+  }
+
+  /**
+   * \returns the positions of the bits that differ between before and after, bit k of byte i is position 8*i + k, or
+   * an empty list and a message if their sizes differ
+   */
+  std::vector<uint64_t> changed_bits(pressio_data const& before, pressio_data const& after) {
+    std::vector<uint64_t> bits;
+    if(before.size_in_bytes() != after.size_in_bytes()) {
+      std::cerr << "the output has " << after.size_in_bytes() << " bytes, expected " << before.size_in_bytes() << std::endl;
+      return bits;
+    }
+    uint8_t const* lhs = static_cast<uint8_t const*>(before.data());
+    uint8_t const* rhs = static_cast<uint8_t const*>(after.data());
+    for (size_t i = 0; i < before.size_in_bytes(); ++i) {
+      for (unsigned int k = 0; k < 8; ++k) {
+        if(((lhs[i] ^ rhs[i]) >> k) & 1) bits.push_back(8 * i + k);
+      }
+    }
+    return bits;
+  }
+
+  uint64_t metric(pressio_options const& metrics, std::string const& name) {
+    uint64_t value = 0;
+    metrics.get(name, &value);
+    return value;
+  }
+
+  bool test_single(pressio& library) {
+    //a single injection into a buffer of a few bytes flips exactly one bit of the buffer, never a byte past its end
+    for (size_t len : {1, 2, 3}) {
+      const pressio_data input = random_bytes(len);
+      for (unsigned int seed = 0; seed < 64; ++seed) {
+        pressio_data output;
+        if(!inject(library, {{"fault_injector:seed", seed}, {"fault_injector:injections", 1u}}, input, output)) return false;
+        if(changed_bits(input, output).size() != 1) {
+          std::cerr << "an injection into " << len << " bytes with seed " << seed << " did not flip one bit" << std::endl;
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool test_bit_error_rate(pressio& library) {
+    //several 1 MiB segments, the last one partial
+    const pressio_data input = random_bytes((size_t{7} << 19) + 123);
+    const double rate = 1e-3;
+    const pressio_options options {
+      {"fault_injector:seed", 3u},
+      {"fault_injector:bit_error_rate", rate},
+    };
+
+    pressio_data output;
+    pressio_options metrics;
+    if(!inject(library, options, input, output, &metrics)) return false;
+    //each affected bit is flipped once, so every fault is accounted for by a changed bit of the buffer
+    const std::vector<uint64_t> bits = changed_bits(input, output);
+    const uint64_t applied = metric(metrics, "fault_injector:faults_applied");
+    if(bits.size() != applied) {
+      std::cerr << applied << " faults were applied but " << bits.size() << " bits of the buffer changed" << std::endl;
+      return false;
+    }
+    const double expected = rate * 8 * static_cast<double>(input.size_in_bytes());
+    if(std::fabs(static_cast<double>(bits.size()) - expected) > 5 * std::sqrt(expected)) {
+      std::cerr << bits.size() << " bits flipped, expected about " << expected << std::endl;
+      return false;
+    }
+
+    pressio_options threaded = options;
+    threaded.set("fault_injector:nthreads", 4u);
+    pressio_data threaded_output;
+    if(!inject(library, threaded, input, threaded_output)) return false;
+    if(std::memcmp(output.data(), threaded_output.data(), output.size_in_bytes()) != 0) {
+      std::cerr << "nthreads changed the faults" << std::endl;
+      return false;
+    }
+
+    //a rate of one flips every bit
+    pressio_data all;
+    if(!inject(library, {{"fault_injector:seed", 3u}, {"fault_injector:bit_error_rate", 1.0}}, input, all)) return false;
+    if(changed_bits(input, all).size() != 8 * input.size_in_bytes()) {
+      std::cerr << "a bit error rate of 1 did not flip every bit" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool test_burst(pressio& library) {
+    //lengths within one byte, spanning 64 bit words, and longer than a word
+    const pressio_data input = random_bytes(301);
+    for (unsigned int length : {1u, 5u, 13u, 64u, 100u}) {
+      for (unsigned int seed = 0; seed < 16; ++seed) {
+        pressio_data output;
+        if(!inject(library, {
+              {"fault_injector:seed", seed},
+              {"fault_injector:fault_model", std::string("burst")},
+              {"fault_injector:burst_length", length},
+            }, input, output)) return false;
+        const std::vector<uint64_t> bits = changed_bits(input, output);
+        if(bits.size() != length || bits.back() - bits.front() + 1 != length) {
+          std::cerr << "a burst of " << length << " with seed " << seed << " did not flip " << length << " contiguous bits" << std::endl;
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool test_multi_bit(pressio& library) {
+    //the last word is partial, so faults there only draw from the bits that exist
+    const pressio_data input = random_bytes(8 * 12 + 3);
+    for (unsigned int bits_per_fault : {1u, 2u, 5u, 17u, 40u}) {
+      for (unsigned int seed = 0; seed < 32; ++seed) {
+        pressio_data output;
+        if(!inject(library, {
+              {"fault_injector:seed", seed},
+              {"fault_injector:fault_model", std::string("multi_bit")},
+              {"fault_injector:bits_per_fault", bits_per_fault},
+            }, input, output)) return false;
+        const std::vector<uint64_t> bits = changed_bits(input, output);
+        const uint64_t word = bits.empty() ? 0 : bits.front() / 64;
+        const uint64_t available = std::min<uint64_t>(64, 8 * input.size_in_bytes() - 64 * word);
+        if(bits.size() != std::min<uint64_t>(bits_per_fault, available) || bits.back() / 64 != word) {
+          std::cerr << "a fault of " << bits_per_fault << " bits with seed " << seed << " flipped " << bits.size()
+            << " bits, expected that many distinct bits within one 64 bit word" << std::endl;
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool test_stuck_at(pressio& library) {
+    const pressio_data input = random_bytes(128);
+    const uint64_t mask = 0x8000000001020304;
+    const size_t region_start = 10, region_length = 37;
+    pressio_data output;
+    pressio_options metrics;
+    if(!inject(library, {
+          {"fault_injector:seed", 0u},
+          {"fault_injector:fault_model", std::string("stuck_at")},
+          {"fault_injector:injection_mode_str", std::string("set")},
+          {"fault_injector:stuck_at_mask", mask},
+          {"fault_injector:region_start", uint64_t{region_start}},
+          {"fault_injector:region_length", uint64_t{region_length}},
+        }, input, output, &metrics)) return false;
+    if(output.size_in_bytes() != input.size_in_bytes()) {
+      std::cerr << "the output has " << output.size_in_bytes() << " bytes, expected " << input.size_in_bytes() << std::endl;
+      return false;
+    }
+
+    //the mask repeats every 8 bytes from the start of the region, the last word cut off at its end
+    uint8_t const* before = static_cast<uint8_t const*>(input.data());
+    uint8_t const* after = static_cast<uint8_t const*>(output.data());
+    for (size_t i = 0; i < input.size_in_bytes(); ++i) {
+      const bool inside = i >= region_start && i < region_start + region_length;
+      const uint8_t stuck = inside ? static_cast<uint8_t>(mask >> (8 * ((i - region_start) % 8))) : 0;
+      if(after[i] != (before[i] | stuck)) {
+        std::cerr << "byte " << i << " is " << unsigned{after[i]} << ", expected " << unsigned(before[i] | stuck) << std::endl;
+        return false;
+      }
+    }
+    const uint64_t words = (region_length + 7) / 8;
+    if(metric(metrics, "fault_injector:faults_applied") != words) {
+      std::cerr << "faults_applied is " << metric(metrics, "fault_injector:faults_applied") << ", expected " << words << std::endl;
+      return false;
+    }
+    return true;
+  }
+  /**
+   * \returns the largest absolute difference between the int32 elements of lhs and rhs
+   */
+  double max_abs_difference(pressio_data const& lhs, pressio_data const& rhs) {
+    int32_t const* lhs_values = static_cast<int32_t const*>(lhs.data());
+    int32_t const* rhs_values = static_cast<int32_t const*>(rhs.data());
+    double error = 0;
+    for (size_t i = 0; i < lhs.num_elements(); ++i) {
+      error = std::max(error, std::fabs(static_cast<double>(lhs_values[i]) - static_cast<double>(rhs_values[i])));
+    }
+    return error;
+  }
+
+  bool test_campaign(pressio& library) {
+    //integers so that no flip makes the error NaN; several injections per trial so a trial that is not restored
+    //carries its faults into the next trial of its group
+    pressio_data input = pressio_data::owning(pressio_int32_dtype, {1024});
+    std::memcpy(input.data(), random_bytes(input.size_in_bytes()).data(), input.size_in_bytes());
+    const unsigned int seed = 11, trials = 9;
+    for (unsigned int nthreads : {1u, 4u}) {
+      pressio_data output;
+      pressio_options metrics;
+      if(!inject(library, {
+            {"fault_injector:seed", seed},
+            {"fault_injector:injections", 5u},
+            {"fault_injector:trials", trials},
+            {"fault_injector:nthreads", nthreads},
+          }, input, output, &metrics)) return false;
+      pressio_data status, max_error;
+      metrics.get("fault_injector:campaign_status", &status);
+      metrics.get("fault_injector:campaign_max_error", &max_error);
+      if(status.num_elements() != trials || max_error.num_elements() != trials) {
+        std::cerr << "the campaign reported " << status.num_elements() << " statuses and " << max_error.num_elements()
+          << " errors, expected " << trials << std::endl;
+        return false;
+      }
+
+      pressio_data single;
+      if(!inject(library, {{"fault_injector:seed", seed}, {"fault_injector:injections", 5u}}, input, single)) return false;
+      if(std::memcmp(output.data(), single.data(), output.size_in_bytes()) != 0) {
+        std::cerr << "running a campaign changed the compressed output" << std::endl;
+        return false;
+      }
+
+      //trial k decompresses exactly the faults of a single compress with seed + k
+      for (unsigned int k = 0; k < trials; ++k) {
+        if(!inject(library, {{"fault_injector:seed", seed + k}, {"fault_injector:injections", 5u}}, input, single)) return false;
+        const double expected = max_abs_difference(input, single);
+        const double actual = static_cast<double const*>(max_error.data())[k];
+        if(static_cast<int32_t const*>(status.data())[k] != 0 || actual != expected) {
+          std::cerr << "trial " << k << " with nthreads " << nthreads << " has max error " << actual << ", expected "
+            << expected << " from seed " << seed + k << std::endl;
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  bool test_bit_fields(pressio& library) {
+    const std::map<std::string, std::pair<unsigned int, unsigned int>> float_fields {
+      {"mantissa", {0, 23}}, {"exponent", {23, 31}}, {"sign", {31, 32}},
+    };
+    const std::map<std::string, std::pair<unsigned int, unsigned int>> double_fields {
+      {"mantissa", {0, 52}}, {"exponent", {52, 63}}, {"sign", {63, 64}},
+    };
+    for (auto const& type : {std::make_pair(pressio_float_dtype, float_fields), std::make_pair(pressio_double_dtype, double_fields)}) {
+      pressio_data input = pressio_data::owning(type.first, {4096});
+      std::memset(input.data(), 0, input.size_in_bytes());
+      const uint64_t element_bits = 8 * pressio_dtype_size(type.first);
+      for (auto const& field : type.second) {
+        //setting bits of zeros means each fault shows up even if it lands on an element twice
+        pressio_data output;
+        if(!inject(library, {
+              {"fault_injector:seed", 5u},
+              {"fault_injector:injections", 500u},
+              {"fault_injector:fault_model", std::string("element_bit")},
+              {"fault_injector:injection_mode_str", std::string("set")},
+              {"fault_injector:bit_fields", std::vector<std::string>{field.first}},
+            }, input, output)) return false;
+        const std::vector<uint64_t> bits = changed_bits(input, output);
+        if(bits.empty()) {
+          std::cerr << "no bits of the " << field.first << " field were set" << std::endl;
+          return false;
+        }
+        for (uint64_t bit : bits) {
+          const uint64_t k = bit % element_bits;
+          if(k < field.second.first || k >= field.second.second) {
+            std::cerr << "bit " << k << " of a " << element_bits << " bit element is outside the " << field.first << " field" << std::endl;
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  bool test_bit_weights(pressio& library) {
+    //few enough faults among many elements that they rarely land on the same bit twice
+    pressio_data input = pressio_data::owning(pressio_int32_dtype, {100000});
+    std::memset(input.data(), 0, input.size_in_bytes());
+    const double weights[] = {0, 0, 1, 0, 3};
+    pressio_data output;
+    if(!inject(library, {
+          {"fault_injector:seed", 5u},
+          {"fault_injector:injections", 4000u},
+          {"fault_injector:fault_model", std::string("element_bit")},
+          {"fault_injector:injection_mode_str", std::string("set")},
+          {"fault_injector:bit_weights", pressio_data::copy(pressio_double_dtype, weights, {5})},
+        }, input, output)) return false;
+    uint64_t counts[32] = {};
+    for (uint64_t bit : changed_bits(input, output)) ++counts[bit % 32];
+    for (unsigned int k = 0; k < 32; ++k) {
+      if(counts[k] != 0 && k != 2 && k != 4) {
+        std::cerr << "bit " << k << " has weight 0 but was set " << counts[k] << " times" << std::endl;
+        return false;
+      }
+    }
+    //bit 4 is chosen for 3/4 of the faults, give or take 7 standard deviations
+    const double fraction = static_cast<double>(counts[4]) / static_cast<double>(counts[2] + counts[4]);
+    if(std::fabs(fraction - 0.75) > 0.05) {
+      std::cerr << "bit 4 was chosen for " << fraction << " of the faults, expected 0.75" << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  libpressio_register_error_injector();
+  const std::map<std::string, bool(*)(pressio&)> tests {
+    {"single", test_single},
+    {"bit_error_rate", test_bit_error_rate},
+    {"burst", test_burst},
+    {"multi_bit", test_multi_bit},
+    {"stuck_at", test_stuck_at},
+    {"campaign", test_campaign},
+    {"bit_fields", test_bit_fields},
+    {"bit_weights", test_bit_weights},
+  };
+  auto test = (argc == 2) ? tests.find(argv[1]) : tests.end();
+  if(test == tests.end()) {
+    std::cerr << "usage: " << argv[0] << " test, where test is one of";
+    for (auto const& name : tests) std::cerr << ' ' << name.first;
+    std::cerr << std::endl;
+    return 1;
+  }
+  pressio library;
+  return test->second(library) ? 0 : 1;
+}
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include "libpressio_ext/cpp/libpressio.h"
+#include "libpressio_error_injector.h"
+
+/**
+ * \file
+ * checks that options which only change how random_error_injector does its work leave the errors unchanged
+ *
+ * each case perturbs the same input with and without the option and compares the decompressed results bit for bit.
+ * The case to run is the first argument so each is its own ctest case.
+ */
+
+namespace {
+  constexpr unsigned int seed = 7;
+
+  /**
+   * \returns a smooth 3-d field whose planes are not a multiple of the block size, so slabs and blocks do not align
+   */
+  pressio_data make_input() {
+    pressio_data input = pressio_data::owning(pressio_float_dtype, {60, 50, 40});
+    float* values = static_cast<float*>(input.data());
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      values[i] = static_cast<float>(std::sin(0.001 * static_cast<double>(i)));
+    }
+    return input;
+  }
+
+  /**
+   * compresses input with a new random_error_injector configured by options and decompresses it into result
+   *
+   * \returns false and prints the error if any step fails
+   */
+  bool perturb(pressio& library, pressio_options const& options, pressio_data const& input, pressio_data& result,
+      pressio_options* metrics = nullptr) {
+    pressio_compressor compressor = library.get_compressor("random_error_injector");
+    if(!compressor) {
+      std::cerr << "random_error_injector is not registered: " << library.err_msg() << std::endl;
+      return false;
+    }
+    const double dist_args[] = {0, 0.01};
+    compressor->set_options({
+        {"random_error_injector:seed", seed},
+        {"random_error_injector:dist_name", std::string("normal_distribution")},
+        {"random_error_injector:dist_args", pressio_data::copy(pressio_double_dtype, dist_args, {2})},
+        {"random_error_injector:block_size", uint64_t{1024}},
+    });
+    if(compressor->set_options(options)) {
+      std::cerr << "set_options failed: " << compressor->error_msg() << std::endl;
+      return false;
+    }
+    pressio_data compressed = pressio_data::empty(pressio_byte_dtype, {});
+    result = pressio_data::owning(input.dtype(), input.dimensions());
+    if(compressor->compress(&input, &compressed) || compressor->decompress(&compressed, &result)) {
+      std::cerr << "injection failed: " << compressor->error_msg() << std::endl;
+      return false;
+    }
+    if(metrics != nullptr) *metrics = compressor->get_metrics_results();
+    return true;
+  }
+
+  /**
+   * \returns true if lhs and rhs have the same dtype, dimensions, and bytes, otherwise prints which differ
+   */
+  bool identical(pressio_data const& lhs, pressio_data const& rhs, std::string const& what) {
+    if(lhs.dtype() != rhs.dtype() || lhs.dimensions() != rhs.dimensions() ||
+       std::memcmp(lhs.data(), rhs.data(), lhs.size_in_bytes()) != 0) {
+      std::cerr << what << " changed the output" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * \returns true if the output with options differs from reference only by the work done to compute it
+   */
+  bool matches(pressio& library, pressio_data const& input, pressio_data const& reference, pressio_options const& options,
+      std::string const& what) {
+    pressio_data result;
+    return perturb(library, options, input, result) && identical(reference, result, what);
+  }
+
+  bool test_threads(pressio& library, pressio_data const& input) {
+    pressio_data reference;
+    return perturb(library, {{"random_error_injector:nthreads", 1u}}, input, reference) &&
+      matches(library, input, reference, {{"random_error_injector:nthreads", 4u}}, "nthreads");
+  }
+
+  bool test_streaming(pressio& library, pressio_data const& input) {
+    pressio_data reference;
+    //slabs of 9000 elements are whole planes but not whole blocks, so the staging buffer carries blocks between slabs
+    return perturb(library, {}, input, reference) &&
+      matches(library, input, reference, {{"random_error_injector:stream_chunk_size", uint64_t{7000}}}, "streaming") &&
+      matches(library, input, reference, {
+          {"random_error_injector:stream_chunk_size", uint64_t{7000}},
+          {"random_error_injector:nthreads", 4u},
+        }, "streaming with threads");
+  }
+
+  /**
+   * \returns true if the error statistics in metrics match those computed directly from input and output
+   */
+  bool stats_match(pressio_data const& input, pressio_data const& output, pressio_options const& metrics) {
+    float const* original = static_cast<float const*>(input.data());
+    float const* perturbed = static_cast<float const*>(output.data());
+    double sum_squared = 0, max_abs = 0;
+    double lo = std::numeric_limits<double>::infinity(), hi = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      const double diff = static_cast<double>(perturbed[i]) - static_cast<double>(original[i]);
+      sum_squared += diff * diff;
+      max_abs = std::max(max_abs, std::fabs(diff));
+      lo = std::min(lo, static_cast<double>(original[i]));
+      hi = std::max(hi, static_cast<double>(original[i]));
+    }
+    const double mse = sum_squared / static_cast<double>(input.num_elements());
+    const std::map<std::string, double> expected {
+      {"random_error_injector:max_abs_error", max_abs},
+      {"random_error_injector:mse", mse},
+      {"random_error_injector:rmse", std::sqrt(mse)},
+      {"random_error_injector:psnr", 20 * std::log10(hi - lo) - 10 * std::log10(mse)},
+    };
+    bool passed = true;
+    for (auto const& metric : expected) {
+      double value = std::numeric_limits<double>::quiet_NaN();
+      metrics.get(metric.first, &value);
+      //the plugin sums squared errors in a different order, so allow for rounding
+      if(!(std::fabs(value - metric.second) <= 1e-9 * std::fabs(metric.second))) {
+        std::cerr << metric.first << " is " << value << ", expected " << metric.second << std::endl;
+        passed = false;
+      }
+    }
+    return passed;
+  }
+
+  /**
+   * \returns true if an exact reconstruction of a constant field reports an infinite psnr rather than 0/0
+   */
+  bool exact_psnr_is_infinite(pressio& library) {
+    pressio_data constant = pressio_data::owning(pressio_float_dtype, {1000});
+    std::fill_n(static_cast<float*>(constant.data()), constant.num_elements(), 1.0f);
+    pressio_data result;
+    pressio_options metrics;
+    //a zero error bound makes the quantize surrogate lossless
+    if(!perturb(library, {
+          {"random_error_injector:compute_error_stats", int32_t{1}},
+          {"random_error_injector:surrogate", std::string("quantize")},
+          {"random_error_injector:error_bound", 0.0},
+        }, constant, result, &metrics)) return false;
+    double psnr = 0;
+    metrics.get("random_error_injector:psnr", &psnr);
+    if(psnr != std::numeric_limits<double>::infinity()) {
+      std::cerr << "psnr of an exact reconstruction is " << psnr << ", expected inf" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool test_stats(pressio& library, pressio_data const& input) {
+    pressio_data reference, result;
+    pressio_options metrics;
+    return exact_psnr_is_infinite(library) && perturb(library, {{"random_error_injector:compute_error_stats", int32_t{0}}}, input, reference) &&
+      perturb(library, {{"random_error_injector:compute_error_stats", int32_t{1}}}, input, result, &metrics) &&
+      identical(reference, result, "compute_error_stats") && stats_match(input, result, metrics) &&
+      matches(library, input, reference, {
+          {"random_error_injector:compute_error_stats", int32_t{1}},
+          {"random_error_injector:nthreads", 4u},
+        }, "compute_error_stats with threads");
+  }
+
+  bool test_pipeline(pressio& library, pressio_data const& input) {
+    pressio_data reference;
+    return perturb(library, {{"random_error_injector:stream_chunk_size", uint64_t{7000}}}, input, reference) &&
+      matches(library, input, reference, {
+          {"random_error_injector:stream_chunk_size", uint64_t{7000}},
+          {"random_error_injector:pipeline_depth", 2u},
+        }, "pipeline_depth");
+  }
+
+  bool test_framing(pressio& library, pressio_data const&) {
+    //child output that happens to start with the stream magic must still round trip
+    const std::string text = "LPEISTM1 is only a header when random_error_injector writes it";
+    pressio_data input = pressio_data::copy(pressio_uint8_dtype, text.data(), {text.size()});
+    const double no_noise[] = {0, 0};
+    pressio_data result;
+    if(!perturb(library, {
+          {"random_error_injector:dist_name", std::string("uniform_int_distribution")},
+          {"random_error_injector:dist_args", pressio_data::copy(pressio_double_dtype, no_noise, {2})},
+        }, input, result) || !identical(input, result, "framing")) return false;
+
+    //a header claiming more dimensions than the stream holds must fail rather than allocate
+    std::string corrupt = "LPEISTM1";
+    const int32_t dtype = pressio_float_dtype;
+    const uint64_t ndims = uint64_t{1} << 60;
+    corrupt.append(reinterpret_cast<char const*>(&dtype), sizeof(dtype));
+    corrupt.append(reinterpret_cast<char const*>(&ndims), sizeof(ndims));
+    pressio_data compressed = pressio_data::copy(pressio_byte_dtype, corrupt.data(), {corrupt.size()});
+    pressio_compressor compressor = library.get_compressor("random_error_injector");
+    pressio_data output = pressio_data::empty(pressio_float_dtype, {});
+    if(compressor->decompress(&compressed, &output) == 0) {
+      std::cerr << "a corrupt stream header was accepted" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool test_in_place(pressio& library, pressio_data const& input) {
+    pressio_data reference;
+    if(!perturb(library, {}, input, reference)) return false;
+
+    //owned host memory is perturbed where it is, so the caller's buffer becomes the output
+    pressio_data owned = pressio_data::clone(input);
+    pressio_data result;
+    if(!perturb(library, {{"random_error_injector:in_place", int32_t{1}}}, owned, result) ||
+       !identical(reference, result, "in_place") || !identical(reference, owned, "perturbing the input in place")) return false;
+
+    //memory the input does not own falls back to the fused copy and is left alone
+    std::vector<float> values(static_cast<float const*>(input.data()), static_cast<float const*>(input.data()) + input.num_elements());
+    const pressio_data borrowed = pressio_data::nonowning(input.dtype(), values.data(), input.dimensions());
+    if(!perturb(library, {{"random_error_injector:in_place", int32_t{1}}}, borrowed, result) ||
+       !identical(reference, result, "in_place with a nonowning input")) return false;
+    if(std::memcmp(values.data(), input.data(), input.size_in_bytes()) != 0) {
+      std::cerr << "in_place modified a nonowning input" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * reads data generated by generate_random_data configured by options into the dtype and dimensions of like
+   *
+   * \returns false and prints the error if reading fails
+   */
+  bool generate(pressio& library, pressio_options const& options, pressio_data const& like, pressio_data& generated) {
+    pressio_io io = library.get_io("generate_random_data");
+    if(!io) {
+      std::cerr << "generate_random_data is not registered: " << library.err_msg() << std::endl;
+      return false;
+    }
+    if(io->set_options(options)) {
+      std::cerr << "set_options failed: " << io->error_msg() << std::endl;
+      return false;
+    }
+    pressio_data shape = pressio_data::empty(like.dtype(), like.dimensions());
+    std::unique_ptr<pressio_data> read(io->read(&shape));
+    if(!read) {
+      std::cerr << "generate_random_data failed: " << io->error_msg() << std::endl;
+      return false;
+    }
+    generated = std::move(*read);
+    return true;
+  }
+
+  bool test_generate(pressio& library, pressio_data const& input) {
+    //noise added to zeros is the noise itself
+    pressio_data zeros = pressio_data::owning(input.dtype(), input.dimensions());
+    std::memset(zeros.data(), 0, zeros.size_in_bytes());
+    pressio_data noise, generated;
+    const double dist_args[] = {0, 0.01};
+    if(!perturb(library, {}, zeros, noise) || !generate(library, {
+          {"generate_random_data:seed", seed},
+          {"generate_random_data:dist_name", std::string("normal_distribution")},
+          {"generate_random_data:dist_args", pressio_data::copy(pressio_double_dtype, dist_args, {2})},
+          {"generate_random_data:block_size", uint64_t{1024}},
+          {"generate_random_data:nthreads", 4u},
+        }, zeros, generated) || !identical(noise, generated, "generate_random_data")) return false;
+
+    //the default distribution must suit integers, so it draws each of the default arguments 0 and 1
+    pressio_data integers;
+    if(!generate(library, {{"generate_random_data:seed", seed}}, pressio_data::empty(pressio_int32_dtype, {1000}), integers)) {
+      return false;
+    }
+    int32_t const* values = static_cast<int32_t const*>(integers.data());
+    const size_t ones = static_cast<size_t>(std::count(values, values + integers.num_elements(), 1));
+    if(static_cast<size_t>(std::count(values, values + integers.num_elements(), 0)) + ones != integers.num_elements() ||
+        ones == 0 || ones == integers.num_elements()) {
+      std::cerr << "the default distribution for int32 did not draw 0 and 1" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * removes dir and the files in it
+   */
+  void remove_directory(std::string const& dir) {
+    if(DIR* entries = opendir(dir.c_str())) {
+      while(dirent* entry = readdir(entries)) {
+        const std::string name = entry->d_name;
+        if(name != "." && name != "..") unlink((dir + "/" + name).c_str());
+      }
+      closedir(entries);
+    }
+    rmdir(dir.c_str());
+  }
+
+  bool test_cache(pressio& library, pressio_data const& input) {
+    char dir_template[] = "/tmp/libpressio_error_injector_XXXXXX";
+    if(mkdtemp(dir_template) == nullptr) {
+      std::perror("mkdtemp");
+      return false;
+    }
+    const std::string dir = dir_template;
+    const pressio_options cached {{"random_error_injector:noise_cache_dir", dir}};
+
+    pressio_data reference, miss, hit;
+    pressio_options miss_metrics, hit_metrics;
+    bool passed = perturb(library, {}, input, reference) &&
+      perturb(library, cached, input, miss, &miss_metrics) && identical(reference, miss, "a noise cache miss") &&
+      perturb(library, cached, input, hit, &hit_metrics) && identical(reference, hit, "a noise cache hit");
+    if(passed) {
+      uint64_t miss_hits = 0, hits = 0;
+      miss_metrics.get("random_error_injector:noise_cache_hits", &miss_hits);
+      hit_metrics.get("random_error_injector:noise_cache_hits", &hits);
+      if(miss_hits != 0 || hits == 0) {
+        std::cerr << "expected a miss then a hit, got " << miss_hits << " then " << hits << " hits" << std::endl;
+        passed = false;
+      }
+    }
+    remove_directory(dir);
+    return passed;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  libpressio_register_error_injector();
+  const std::map<std::string, bool(*)(pressio&, pressio_data const&)> tests {
+    {"threads", test_threads},
+    {"cache", test_cache},
+    {"streaming", test_streaming},
+    {"stats", test_stats},
+    {"pipeline", test_pipeline},
+    {"framing", test_framing},
+    {"generate", test_generate},
+    {"in_place", test_in_place},
+  };
+  auto test = (argc == 2) ? tests.find(argv[1]) : tests.end();
+  if(test == tests.end()) {
+    std::cerr << "usage: " << argv[0] << " test, where test is one of";
+    for (auto const& name : tests) std::cerr << ' ' << name.first;
+    std::cerr << std::endl;
+    return 1;
+  }
+  pressio library;
+  const pressio_data input = make_input();
+  return test->second(library, input) ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "libpressio_ext/cpp/libpressio.h"
+#include "libpressio_error_injector.h"
+
+/**
+ * \file
+ * checks that the modes of random_error_injector which change where and how much noise is added do what they document
+ *
+ * The case to run is the first argument so each is its own ctest case.
+ */
+
+namespace {
+  constexpr unsigned int seed = 13;
+
+  /**
+   * compresses input with a new random_error_injector configured by options and decompresses it into result
+   *
+   * \returns false and prints the error if any step fails
+   */
+  bool perturb(pressio& library, pressio_options const& options, pressio_data const& input, pressio_data& result) {
+    pressio_compressor compressor = library.get_compressor("random_error_injector");
+    if(!compressor) {
+      std::cerr << "random_error_injector is not registered: " << library.err_msg() << std::endl;
+      return false;
+    }
+    const double dist_args[] = {0, 0.01};
+    compressor->set_options({
+        {"random_error_injector:seed", seed},
+        {"random_error_injector:dist_name", std::string("normal_distribution")},
+        {"random_error_injector:dist_args", pressio_data::copy(pressio_double_dtype, dist_args, {2})},
+    });
+    if(compressor->set_options(options)) {
+      std::cerr << "set_options failed: " << compressor->error_msg() << std::endl;
+      return false;
+    }
+    pressio_data compressed = pressio_data::empty(pressio_byte_dtype, {});
+    result = pressio_data::owning(input.dtype(), input.dimensions());
+    if(compressor->compress(&input, &compressed) || compressor->decompress(&compressed, &result)) {
+      std::cerr << "injection failed: " << compressor->error_msg() << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool test_relative(pressio& library) {
+    //a range of about 100 and values near zero, so absolute, range, and value scaling all differ
+    pressio_data input = pressio_data::owning(pressio_double_dtype, {10000});
+    double* values = static_cast<double*>(input.data());
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      values[i] = 50 * std::sin(0.01 * static_cast<double>(i)) + 3;
+    }
+    const double range = *std::max_element(values, values + input.num_elements()) -
+      *std::min_element(values, values + input.num_elements());
+
+    pressio_data absolute, range_scaled, value_scaled;
+    if(!perturb(library, {{"random_error_injector:relative", std::string("absolute")}}, input, absolute) ||
+       !perturb(library, {{"random_error_injector:relative", std::string("range")}}, input, range_scaled) ||
+       !perturb(library, {{"random_error_injector:relative", std::string("value")}}, input, value_scaled)) return false;
+
+    //the same noise is drawn in each mode, only its scale differs
+    double const* noisy = static_cast<double const*>(absolute.data());
+    double const* by_range = static_cast<double const*>(range_scaled.data());
+    double const* by_value = static_cast<double const*>(value_scaled.data());
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      //recovering the noise from the absolute output rounds it to the precision of the values
+      const double noise = noisy[i] - values[i], tolerance = 1e-10;
+      if(!(std::fabs((by_range[i] - values[i]) - range * noise) <= tolerance)) {
+        std::cerr << "element " << i << " has range scaled error " << by_range[i] - values[i] << ", expected "
+          << range * noise << std::endl;
+        return false;
+      }
+      if(!(std::fabs((by_value[i] - values[i]) - std::fabs(values[i]) * noise) <= tolerance)) {
+        std::cerr << "element " << i << " has value scaled error " << by_value[i] - values[i] << ", expected "
+          << std::fabs(values[i]) * noise << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+  bool test_correlated(pressio& library) {
+    //noise added to zeros is the noise itself
+    pressio_data zeros = pressio_data::owning(pressio_double_dtype, {256, 256});
+    std::memset(zeros.data(), 0, zeros.size_in_bytes());
+    const double mean = 0.5, stddev = 0.2, lengths[] = {4, 4};
+    const double dist_args[] = {mean, stddev};
+    pressio_data white, correlated;
+    if(!perturb(library, {{"random_error_injector:dist_args", pressio_data::copy(pressio_double_dtype, dist_args, {2})}},
+          zeros, white) || !perturb(library, {
+          {"random_error_injector:dist_args", pressio_data::copy(pressio_double_dtype, dist_args, {2})},
+          {"random_error_injector:correlation_length", pressio_data::copy(pressio_double_dtype, lengths, {2})},
+          {"random_error_injector:nthreads", 4u},
+        }, zeros, correlated)) return false;
+
+    auto moments = [](pressio_data const& data, double& sample_mean, double& variance, double& lag_one) {
+      double const* values = static_cast<double const*>(data.data());
+      const size_t n = data.num_elements();
+      sample_mean = 0;
+      for (size_t i = 0; i < n; ++i) sample_mean += values[i];
+      sample_mean /= static_cast<double>(n);
+      variance = lag_one = 0;
+      for (size_t i = 0; i < n; ++i) {
+        variance += (values[i] - sample_mean) * (values[i] - sample_mean);
+        //neighbours along dimension 0, wrapping at the end of each row like the periodic kernel
+        lag_one += (values[i] - sample_mean) * (values[(i % 256 == 255) ? i - 255 : i + 1] - sample_mean);
+      }
+      lag_one /= variance;
+      variance /= static_cast<double>(n);
+    };
+    double white_mean, white_variance, white_lag, correlated_mean, correlated_variance, correlated_lag;
+    moments(white, white_mean, white_variance, white_lag);
+    moments(correlated, correlated_mean, correlated_variance, correlated_lag);
+
+    //convolving restores the mean of the white noise exactly; a length of 4 leaves about 300 independent samples, so
+    //the variance is only within about five standard errors of the distribution's
+    if(std::fabs(correlated_mean - white_mean) > 1e-9 || std::fabs(correlated_mean - mean) > 0.01) {
+      std::cerr << "the correlated noise has mean " << correlated_mean << ", white noise " << white_mean << std::endl;
+      return false;
+    }
+    if(std::fabs(correlated_variance / (stddev * stddev) - 1) > 0.25) {
+      std::cerr << "the correlated noise has variance " << correlated_variance << ", expected " << stddev * stddev << std::endl;
+      return false;
+    }
+    //neighbours of a Gaussian kernel of length 4 have a correlation of exp(-1/64)
+    if(correlated_lag < 0.9 || std::fabs(white_lag) > 0.05) {
+      std::cerr << "neighbours have correlation " << correlated_lag << " with correlated noise and " << white_lag
+        << " with white noise" << std::endl;
+      return false;
+    }
+    return true;
+  }
+  /**
+   * \returns true if output differs from input exactly in the elements where selected is true, allowing for the rare
+   * selected element whose noise rounds away
+   */
+  bool only_selected_changed(pressio_data const& input, pressio_data const& output, std::vector<bool> const& selected,
+      std::string const& what) {
+    float const* before = static_cast<float const*>(input.data());
+    float const* after = static_cast<float const*>(output.data());
+    size_t inside = 0, changed = 0;
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      const bool differs = std::memcmp(before + i, after + i, sizeof(float)) != 0;
+      if(!selected[i] && differs) {
+        std::cerr << what << " changed element " << i << " outside the region of interest" << std::endl;
+        return false;
+      }
+      inside += selected[i];
+      changed += differs;
+    }
+    if(changed < inside * 99 / 100) {
+      std::cerr << what << " changed " << changed << " of the " << inside << " elements in the region of interest" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool test_region(pressio& library) {
+    const std::vector<size_t> dims {60, 50, 40};
+    pressio_data input = pressio_data::owning(pressio_float_dtype, dims);
+    float* values = static_cast<float*>(input.data());
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      values[i] = static_cast<float>(std::sin(0.001 * static_cast<double>(i)));
+    }
+
+    //a strided hyperslab along every dimension
+    const uint64_t start[] = {5, 10, 0}, count[] = {20, 15, 14}, stride[] = {2, 1, 3};
+    std::vector<bool> in_slab(input.num_elements());
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      size_t index = i;
+      bool inside = true;
+      for (size_t d = 0; d < dims.size(); ++d) {
+        const size_t x = index % dims[d];
+        index /= dims[d];
+        inside = inside && x >= start[d] && (x - start[d]) % stride[d] == 0 && (x - start[d]) / stride[d] < count[d];
+      }
+      in_slab[i] = inside;
+    }
+    pressio_data slab_output;
+    if(!perturb(library, {
+          {"random_error_injector:roi_start", pressio_data::copy(pressio_uint64_dtype, start, {3})},
+          {"random_error_injector:roi_count", pressio_data::copy(pressio_uint64_dtype, count, {3})},
+          {"random_error_injector:roi_stride", pressio_data::copy(pressio_uint64_dtype, stride, {3})},
+          {"random_error_injector:nthreads", 4u},
+        }, input, slab_output) || !only_selected_changed(input, slab_output, in_slab, "a hyperslab")) return false;
+
+    //a mask of runs of varying length
+    pressio_data mask = pressio_data::owning(pressio_uint8_dtype, dims);
+    uint8_t* mask_values = static_cast<uint8_t*>(mask.data());
+    std::vector<bool> in_mask(input.num_elements());
+    for (size_t i = 0; i < input.num_elements(); ++i) {
+      in_mask[i] = (i / 7) % 3 == 0 || i % 11 == 0;
+      mask_values[i] = in_mask[i] ? 1 : 0;
+    }
+    pressio_data mask_output;
+    return perturb(library, {{"random_error_injector:roi_mask", mask}}, input, mask_output) &&
+      only_selected_changed(input, mask_output, in_mask, "a mask");
+  }
+}
+
+int main(int argc, char* argv[]) {
+  libpressio_register_error_injector();
+  const std::map<std::string, bool(*)(pressio&)> tests {
+    {"relative", test_relative},
+    {"correlated", test_correlated},
+    {"region", test_region},
+  };
+  auto test = (argc == 2) ? tests.find(argv[1]) : tests.end();
+  if(test == tests.end()) {
+    std::cerr << "usage: " << argv[0] << " test, where test is one of";
+    for (auto const& name : tests) std::cerr << ' ' << name.first;
+    std::cerr << std::endl;
+    return 1;
+  }
+  pressio library;
+  return test->second(library) ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "libpressio_error_injector.h"
+#include "random_distributions.h"
+#include "simd_distributions.h"
+
+/**
+ * \file
+ * checks that the bulk paths of the simd distributions agree with their scalar operator()
+ */
+
+namespace {
+  //longer than a chunk and odd, so a bulk call without a pending sample ends with a scalar call
+  constexpr size_t n = 1001;
+
+  std::unique_ptr<polymorphic_generator> seeded_generator() {
+    auto gen = generator_registry().build("mt19937_64");
+    std::seed_seq seq{7u};
+    gen->seed(seq);
+    return gen;
+  }
+
+  /**
+   * runs bulk on a distribution which has a sample pending from operator() and checks that the sample is the first one
+   * bulk uses, followed by the samples a fresh distribution draws from the same generator state
+   *
+   * bulk is called with the distribution, the generator, and the number of samples, and returns the noise it added
+   */
+  template <class Bulk>
+  bool uses_pending_sample(Bulk&& bulk, std::string const& what) {
+    auto gen = seeded_generator();
+    simd_normal_distribution<double> dist(1, 2);
+    dist(*gen);
+    //a copy returns the pending sample without drawing from the generator
+    auto pending = dist;
+    const double expected_first = pending(*gen);
+
+    auto reference_gen = gen->clone();
+    simd_normal_distribution<double> reference(1, 2);
+    std::vector<double> expected(n);
+    expected[0] = expected_first;
+    reference.fill(expected.data() + 1, expected.data() + n, *reference_gen);
+
+    const std::vector<double> noise = bulk(dist, *gen, n);
+    for (size_t i = 0; i < n; ++i) {
+      if(!(std::fabs(noise[i] - expected[i]) <= 1e-12 * std::max(1.0, std::fabs(expected[i])))) {
+        std::cerr << what << " sample " << i << " is " << noise[i] << ", expected " << expected[i] << std::endl;
+        return false;
+      }
+    }
+    //neither is left with a pending sample, so they continue identically
+    if(dist(*gen) != reference(*reference_gen) || dist(*gen) != reference(*reference_gen)) {
+      std::cerr << "operator() after " << what << " differs from a distribution which had no pending sample" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool test_pending_sample() {
+    const double offset = 3;
+    return uses_pending_sample([](simd_normal_distribution<double>& dist, polymorphic_generator& gen, size_t count) {
+        std::vector<double> values(count);
+        dist.fill(values.data(), values.data() + count, gen);
+        return values;
+      }, "fill") &
+      uses_pending_sample([offset](simd_normal_distribution<double>& dist, polymorphic_generator& gen, size_t count) {
+        std::vector<double> values(count, offset);
+        dist.add_to(values.data(), values.data() + count, gen);
+        for (auto& value : values) value -= offset;
+        return values;
+      }, "add_to") &
+      uses_pending_sample([offset](simd_normal_distribution<double>& dist, polymorphic_generator& gen, size_t count) {
+        std::vector<double> src(count, offset), values(count);
+        dist.add_to(src.data(), src.data() + count, values.data(), gen);
+        for (auto& value : values) value -= offset;
+        return values;
+      }, "add_to with a source");
+  }
+
+  bool test_uniform() {
+    //without a pending sample the bulk path draws the same values as repeated scalar calls
+    auto gen = seeded_generator();
+    auto scalar_gen = gen->clone();
+    simd_uniform_real_distribution<float> dist(-1, 1), scalar(-1, 1);
+    std::vector<float> values(n);
+    dist.fill(values.data(), values.data() + n, *gen);
+    for (size_t i = 0; i < n; ++i) {
+      const float expected = scalar(*scalar_gen);
+      if(!(std::fabs(values[i] - expected) <= 1e-6f)) {
+        std::cerr << "sample " << i << " is " << values[i] << ", expected " << expected << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  libpressio_register_error_injector();
+  const std::map<std::string, bool(*)()> tests {
+    {"pending_sample", test_pending_sample},
+    {"uniform", test_uniform},
+  };
+  auto test = (argc == 2) ? tests.find(argv[1]) : tests.end();
+  if(test == tests.end()) {
+    std::cerr << "usage: " << argv[0] << " test, where test is one of";
+    for (auto const& name : tests) std::cerr << ' ' << name.first;
+    std::cerr << std::endl;
+    return 1;
+  }
+  return test->second() ? 0 : 1;
+}
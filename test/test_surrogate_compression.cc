@@ -0,0 +1,189 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "surrogate_compression.h"
+
+/**
+ * \file
+ * checks the error bounds of the surrogate compressors and that the predict surrogate matches a serial predictor
+ * whether a row is reconstructed at once, in place, or across several calls
+ */
+
+namespace {
+  const double bounds[] = {1e-1, 1e-4, 1e-7};
+
+  /**
+   * \returns a random walk around 5000 with occasional jumps, so float grid points often round outside small bounds
+   * and residuals sometimes need too many bins
+   */
+  template <class T>
+  std::vector<T> make_walk(size_t n) {
+    std::mt19937_64 gen(17);
+    std::normal_distribution<double> step(0, 1);
+    std::bernoulli_distribution jump(0.01);
+    std::vector<T> values(n);
+    double value = 5000;
+    for (auto& v : values) {
+      value += step(gen) + (jump(gen) ? 1e6 * step(gen) : 0);
+      v = static_cast<T>(value);
+    }
+    return values;
+  }
+
+  /**
+   * the previous value predictor written as one loop over elements, storing an element exactly and re-anchoring the
+   * grid whenever its grid point is outside the bound or its residual needs too many bins
+   */
+  template <class T>
+  std::vector<T> serial_predict(std::vector<T> const& src, size_t row_length, double bound) {
+    const double step = 2 * bound, inverse = 1 / step;
+    std::vector<T> dst(src.size());
+    double anchor = 0;
+    for (size_t i = 0; i < src.size(); ++i) {
+      const double value = static_cast<double>(src[i]);
+      const T reconstructed = grid_point<T>(value, anchor, inverse, step);
+      if(i % row_length != 0 && std::fabs(static_cast<double>(reconstructed) - value) <= bound &&
+          std::fabs((static_cast<double>(reconstructed) - static_cast<double>(dst[i - 1])) * inverse) < (1 << 15)) {
+        dst[i] = reconstructed;
+      } else {
+        dst[i] = src[i];
+        anchor = value;
+      }
+    }
+    return dst;
+  }
+
+  /**
+   * \returns true if each element of dst is within bound, scaled by the magnitude of src if relative, of src
+   */
+  template <class T>
+  bool within_bound(std::vector<T> const& src, std::vector<T> const& dst, double bound, bool relative, std::string const& what) {
+    for (size_t i = 0; i < src.size(); ++i) {
+      const double value = static_cast<double>(src[i]);
+      const double error = std::fabs(static_cast<double>(dst[i]) - value);
+      if(!(error <= (relative ? bound * std::fabs(value) : bound))) {
+        std::cerr << what << ": element " << i << " has error " << error << " with bound " << bound << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <class T>
+  bool identical(std::vector<T> const& lhs, std::vector<T> const& rhs, std::string const& what) {
+    if(std::memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(T)) != 0) {
+      std::cerr << what << " differs" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  template <class T>
+  bool check_quantize(const char* type) {
+    const std::vector<T> src = make_walk<T>(100000);
+    bool passed = true;
+    for (double bound : bounds) {
+      std::vector<T> dst(src.size());
+      surrogate_quantize(src.data(), dst.data(), src.size(), bound, 4096, 4);
+      passed &= within_bound(src, dst, bound, false, std::string("quantize ") + type);
+    }
+    return passed;
+  }
+
+  bool test_quantize() {
+    return check_quantize<float>("float") & check_quantize<double>("double");
+  }
+
+  template <class T>
+  bool check_predict(const char* type) {
+    const size_t row_length = 1000;
+    const std::vector<T> src = make_walk<T>(100 * row_length + 17);
+    bool passed = true;
+    for (double bound : bounds) {
+      const std::string what = std::string("predict ") + type + " with bound " + std::to_string(bound);
+      std::vector<T> dst(src.size());
+      surrogate_predict(src.data(), dst.data(), src.size(), bound, row_length, 4);
+      passed &= within_bound(src, dst, bound, false, what) &&
+        identical(serial_predict(src, row_length, bound), dst, what + " compared to a serial predictor");
+
+      std::vector<T> in_place = src;
+      surrogate_predict(in_place.data(), in_place.data(), in_place.size(), bound, row_length, 4);
+      passed &= identical(dst, in_place, what + " in place");
+    }
+    return passed;
+  }
+
+  bool test_predict() {
+    return check_predict<float>("float") & check_predict<double>("double");
+  }
+
+  template <class T>
+  bool check_truncate(const char* type) {
+    std::vector<T> src = make_walk<T>(100000);
+    src[0] = 0;
+    bool passed = true;
+    for (double bound : bounds) {
+      std::vector<T> dst(src.size());
+      surrogate_truncate(src.data(), dst.data(), src.size(), bound, 4096, 4);
+      passed &= within_bound(src, dst, bound, true, std::string("truncate ") + type);
+    }
+    return passed;
+  }
+
+  bool test_truncate() {
+    return check_truncate<float>("float") & check_truncate<double>("double");
+  }
+
+  template <class T>
+  bool check_split_rows(const char* type) {
+    const size_t row_length = 1000;
+    const std::vector<T> src = make_walk<T>(20 * row_length + 333);
+    bool passed = true;
+    for (double bound : bounds) {
+      std::vector<T> whole(src.size());
+      surrogate_predict(src.data(), whole.data(), src.size(), bound, row_length, 4);
+      //slabs shorter than a row, longer than a row, and neither aligned with rows
+      for (size_t slab : {size_t{7}, size_t{377}, size_t{2500}}) {
+        for (bool with_stats : {false, true}) {
+          std::vector<T> split = src;
+          std::vector<error_stats> stats;
+          predict_carry carry;
+          for (size_t offset = 0; offset < src.size(); offset += slab) {
+            const size_t len = std::min(slab, src.size() - offset);
+            surrogate_predict(split.data() + offset, split.data() + offset, len, bound, row_length, 4,
+                with_stats ? &stats : nullptr, offset, &carry);
+          }
+          passed &= identical(whole, split, std::string("predict ") + type + " in slabs of " + std::to_string(slab) +
+              (with_stats ? " with stats" : ""));
+        }
+      }
+    }
+    return passed;
+  }
+
+  bool test_split_rows() {
+    return check_split_rows<float>("float") & check_split_rows<double>("double");
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const std::map<std::string, bool(*)()> tests {
+    {"quantize", test_quantize},
+    {"predict", test_predict},
+    {"truncate", test_truncate},
+    {"split_rows", test_split_rows},
+  };
+  auto test = (argc == 2) ? tests.find(argv[1]) : tests.end();
+  if(test == tests.end()) {
+    std::cerr << "usage: " << argv[0] << " test, where test is one of";
+    for (auto const& name : tests) std::cerr << ' ' << name.first;
+    std::cerr << std::endl;
+    return 1;
+  }
+  return test->second() ? 0 : 1;
+}